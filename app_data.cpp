@@ -19,28 +19,39 @@
 #include "APP_DATA.h"
 #include <ESP_EEPROM.h>
 
+// layout of the EEPROM: data, WIFI cache, schedule, UDP counter
+#define SCHEDULE_OFFSET (sizeof(EEPROMStruct) + sizeof(WIFICacheStruct))
+#define UDP_OFFSET      (SCHEDULE_OFFSET + sizeof(SCHEDULEStruct))
+#define EEPROM_SIZE     (UDP_OFFSET + sizeof(UDPStruct))
+
 /*!
- *  @brief  Debug function to print EEPROM data to Serial.
+ *  @brief  Debug function to log the EEPROM data, the WIFI password is not shown.
  *  @param  eepromData  Pointer to the EEPROM data structure.
  */
 void debugEEprom(const EEPROMStruct* eepromData) {
-  char buf[30];
-
-  Serial.print("SSID:");
-  Serial.println(eepromData->wifiSSID);
-  Serial.print("PW:");
-  Serial.println(eepromData->wifiPassword);
-  Serial.print("MQTT port:");
-  Serial.println(eepromData->mqttBrokerPort);
-  Serial.print("MQTT ip:");
-  sprintf(buf, "%d.%d.%d.%d", eepromData->mqttBrokerIp[0],eepromData->mqttBrokerIp[1],eepromData->mqttBrokerIp[2],eepromData->mqttBrokerIp[3] );
-  Serial.println(buf);
-  Serial.print("DHT Temp Level:");
-  Serial.println(eepromData->dhtTempLevel);
-  Serial.print("DHT Hum Level:");
-  Serial.println(eepromData->dhtHumLevel);
-  Serial.print("DHT Temp Offset:");
-  Serial.println(eepromData->dhtTemperaturOffset);
+  LOG_DEBUG("SSID: %s, PW: %u chars", eepromData->wifiSSID, (unsigned)strnlen(eepromData->wifiPassword, sizeof(eepromData->wifiPassword)));
+  LOG_DEBUG("MQTT ip: %d.%d.%d.%d, port: %d", eepromData->mqttBrokerIp[0], eepromData->mqttBrokerIp[1],
+            eepromData->mqttBrokerIp[2], eepromData->mqttBrokerIp[3], (int)eepromData->mqttBrokerPort);
+  LOG_DEBUG("DHT Temp Level: %.2f, Hum Level: %d, Temp Offset: %d", (double)eepromData->dhtTempLevel,
+            eepromData->dhtHumLevel, eepromData->dhtTemperaturOffset);
+  LOG_DEBUG("Device ID: %s, group: %s", eepromData->deviceId, eepromData->deviceGroup);
+}
+
+/*!
+ *  @brief  CRC32 (IEEE) of a memory block, bitwise to save the table.
+ *  @param  data    Pointer to the block.
+ *  @param  length  Size of the block in bytes.
+ *  @return The CRC.
+ */
+static uint32_t crc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xffffffff;
+  while (length--) {
+    crc ^= *data++;
+    for (byte bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
 }
 
 /*!
@@ -57,19 +68,20 @@ void debugEEprom(const EEPROMStruct* eepromData) {
  *  @return The percentage used (0-100) or -1 if the flash does not hold any copies of the data.
  */
 void APP_DATA::initialize(const char* ssid, const char* pw, const char* brokerIp, const int brokerPort) {
+  // changes already taken but still waiting for the store delay are not lost by reading the flash again
+  flushEEProm();
   this->brokerIp = IPAddress(0, 0, 0, 0);
   this->wifiIp = IPAddress(0, 0, 0, 0);
   this->dataUpdate = DATA_UPDATE::DATA_UNSET;
 
   boolean valid = readEEpromData();
   if (!valid) {
-    Serial.println("init EEProm with defaults, since eeprom data is not valid");
+    LOG_INFO("init EEProm with defaults, since eeprom data is not valid");
     strncpy(this->sData.wifiSSID, ssid, sizeof(this->sData.wifiSSID) - 1);
     strncpy(this->sData.wifiPassword, pw, sizeof(this->sData.wifiPassword) - 1);
     int ipPart1, ipPart2, ipPart3, ipPart4;
     if (sscanf(brokerIp, "%d.%d.%d.%d", &ipPart1, &ipPart2, &ipPart3, &ipPart4) != 4) {
-      Serial.print("invalid broker IP: ");
-      Serial.println(brokerIp);
+      LOG_WARN("invalid broker IP: %s", brokerIp);
     }
     this->sData.mqttBrokerIp[0] = (byte)ipPart1; this->sData.mqttBrokerIp[1] = (byte)ipPart2; 
     this->sData.mqttBrokerIp[2] = (byte)ipPart3; this->sData.mqttBrokerIp[3] = (byte)ipPart4;
@@ -80,9 +92,61 @@ void APP_DATA::initialize(const char* ssid, const char* pw, const char* brokerIp
     this->sData.dhtTemperaturOffset = 0;  
     this->sData.dataValid = EEPROM_DATA_TOSTORE;
   }
+  // data of a previous version or defaults, the chip ID keeps the device apart from the others on the broker
+  if (!this->sData.deviceId[0] || !validDeviceName(this->sData.deviceId, sizeof(this->sData.deviceId))) {
+    setDeviceId("");
+  }
+  if (!validDeviceName(this->sData.deviceGroup, sizeof(this->sData.deviceGroup))) {
+    setDeviceGroup("");
+  }
+  this->connectedData = this->sData;
   debugEEprom(&sData);
 }
 
+/*!
+ *  @brief  Takes the WIFI and MQTT parameters of a successful connection, they are stored from now on.
+ */
+void APP_DATA::confirmConnection() {
+  this->connectedData = this->sData;
+  storeEEProm();
+}
+
+/*!
+ *  @brief  Sets WIFI and MQTT parameters, device ID and group back to the last working connection.
+ *
+ *  Used when new parameters fail to connect. All other data and pending stores are kept, the flash is not read.
+ *
+ *  @return True if the WIFI parameters changed and WIFI has to connect again.
+ */
+boolean APP_DATA::restoreConnection() {
+  boolean wifiChanged = (strncmp(this->sData.wifiSSID, this->connectedData.wifiSSID, sizeof(this->sData.wifiSSID)) != 0)
+      || (strncmp(this->sData.wifiPassword, this->connectedData.wifiPassword, sizeof(this->sData.wifiPassword)) != 0);
+  copyConnection(this->sData, this->connectedData);
+  if (wifiChanged) {
+    // the cache of the previous network
+    this->sCache = this->storedCache;
+  }
+  return wifiChanged;
+}
+
+/*!
+ *  @brief  Checks a device ID or group, it is used as a level of MQTT topics.
+ *  @param  name  The zero terminated name.
+ *  @param  size  Size of the field holding the name incl. terminator.
+ *  @return True if the name is terminated within size and only has letters, digits, '-' and '_'.
+ */
+boolean APP_DATA::validDeviceName(const char* name, const size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (!name[i]) {
+      return true;
+    }
+    if (!isalnum((unsigned char)name[i]) && (name[i] != '-') && (name[i] != '_')) {
+      return false;
+    }
+  }
+  return false;
+}
+
 /*!
  *  @brief  Sets the new data flag.
  *  @param  dataUpdate  The data update flag to set.
@@ -107,6 +171,66 @@ void APP_DATA::clearNewDataFlag(DATA_UPDATE dataUpdate) {
   this->dataUpdate = (DATA_UPDATE)((byte)this->dataUpdate & ~(byte)dataUpdate);
 }
 
+/*!
+ *  @brief  Writes the command queues and the last sent commands to RTC user memory, if they changed.
+ *
+ *  The RTC memory keeps its content during a watchdog, exception or software reset,
+ *  a restarted application continues with the commands that were still waiting. The queues are taken
+ *  in turns, so RTC_STATE_CMDS keeps the oldest commands of every bus. The UDP counter is kept as well,
+ *  it is ahead of the EEPROM until the deferred store.
+ */
+void APP_DATA::saveRuntimeState() {
+  if (this->runtimeVersion == this->savedRuntimeVersion) {
+    return;
+  }
+  this->savedRuntimeVersion = this->runtimeVersion;
+  RTCStateStruct state;
+  memset(&state, 0, sizeof(state));
+  state.magic = RTC_STATE_MAGIC;
+  for (uint16_t i = 0; i < HUNTER_CMD_QUEUE_SIZE; i++) {
+    for (byte c = 0; c < HUNTER_CONTROLLERS; c++) {
+      if ((i < this->hunterCmds[c].size()) && (state.cmdCount < RTC_STATE_CMDS)) {
+        state.cmds[state.cmdCount++] = this->hunterCmds[c].at(i);
+      }
+    }
+  }
+  memcpy(state.lastCmds, this->lastHunterCmds, sizeof(state.lastCmds));
+  state.udpCounter = this->udpCounter;
+  state.crc = crc32((const uint8_t*)&state.cmds, sizeof(state) - offsetof(RTCStateStruct, cmds));
+  if (!ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, (uint32_t*)&state, sizeof(state))) {
+    LOG_ERROR("RTC state not written");
+  }
+}
+
+/*!
+ *  @brief  Takes the runtime state of the previous run from RTC user memory.
+ *
+ *  After a power cycle the RTC memory is random, the CRC rejects it. Called once at start,
+ *  before any other command is queued.
+ *
+ *  @return True if a valid state was restored.
+ */
+boolean APP_DATA::restoreRuntimeState() {
+  RTCStateStruct state;
+  if (!ESP.rtcUserMemoryRead(RTC_STATE_OFFSET, (uint32_t*)&state, sizeof(state))
+      || (state.magic != RTC_STATE_MAGIC) || (state.cmdCount > RTC_STATE_CMDS)
+      || (state.crc != crc32((const uint8_t*)&state.cmds, sizeof(state) - offsetof(RTCStateStruct, cmds)))) {
+    return false;
+  }
+  for (uint32_t i = 0; i < state.cmdCount; i++) {
+    STATS_ONLY(state.cmds[i].received = micros();)
+    pushHunterCmd(state.cmds[i]);
+  }
+  memcpy(this->lastHunterCmds, state.lastCmds, sizeof(this->lastHunterCmds));
+  if ((state.udpCounter < this->sUdp.udpReserve) || (state.udpCounter > this->udpCounter)) {
+    // the exact UDP counter of the previous run, senders do not have to skip the reserve, which is kept.
+    // Above the reserve it was accepted by a version storing the counter itself, the higher one is taken
+    this->udpCounter = state.udpCounter;
+  }
+  this->savedRuntimeVersion = this->runtimeVersion;
+  return true;
+}
+
 // ======= private functions ===================================================
 
 /*!
@@ -116,27 +240,48 @@ void APP_DATA::clearNewDataFlag(DATA_UPDATE dataUpdate) {
 boolean APP_DATA::readEEpromData() {
   boolean ret = false;
   // Read EEPROM and use it if present
-  EEPROM.begin(sizeof(EEPROMStruct));
+  EEPROM.begin(EEPROM_SIZE);
   // Check if the EEPROM contains valid data from another run
   // If so, overwrite the 'default' values set up in our struct
   if(EEPROM.percentUsed()>=0) {
-    Serial.println("READ: EEPROM has data from a previous run.");
-    Serial.print(EEPROM.percentUsed());
-    Serial.println("% of ESP flash space currently used");
+    LOG_INFO("READ: EEPROM has data from a previous run, %d%% of ESP flash space currently used", EEPROM.percentUsed());
     EEPROM.get(0, (EEPROMStruct&)this->sData); 
+    EEPROM.get(sizeof(EEPROMStruct), (WIFICacheStruct&)this->sCache);
+    EEPROM.get(SCHEDULE_OFFSET, (SCHEDULEStruct&)this->sSchedule);
+    EEPROM.get(UDP_OFFSET, (UDPStruct&)this->sUdp);
     if ((this->sData.dataValid == EEPROM_DATA_VALID) || (this->sData.dataValid == EEPROM_DATA_TOSTORE)) {
-      Serial.println("read eeprom data is valid");
+      LOG_DEBUG("read eeprom data is valid");
       ret = true;  
     } 
   }
+  // flash content is the reference for the next store, initialize() has written pending requests before
+  this->storedData = this->sData;
+  this->storedCache = this->sCache;
+  this->storedSchedule = this->sSchedule;
+  this->storedUdp = this->sUdp;
+  this->storedValid = ret;
+  this->storePending = false;
+  if ((ret == false) || (getWifiCache() == nullptr)) {
+    // no fast reconnect without a valid cache 
+    memset(&this->sCache, 0, sizeof(WIFICacheStruct));
+  }
+  if ((ret == false) || ((this->sSchedule.dataValid != EEPROM_DATA_VALID) && (this->sSchedule.dataValid != EEPROM_DATA_TOSTORE))) {
+    // no schedule stored yet
+    memset(&this->sSchedule, 0, sizeof(SCHEDULEStruct));
+  }
+  if ((ret == false) || ((this->sUdp.dataValid != EEPROM_DATA_VALID) && (this->sUdp.dataValid != EEPROM_DATA_TOSTORE))) {
+    // no datagram accepted yet
+    memset(&this->sUdp, 0, sizeof(UDPStruct));
+  }
+  if (this->sUdp.udpReserve > this->udpCounter) {
+    // counters up to the reserve may have been accepted before a power cycle
+    this->udpCounter = this->sUdp.udpReserve;
+  }
+  this->scheduleVersion++;
   if (ret == false) {
     // clear EEProm data struct
-    Serial.println("eeprom data is invalid, clearing");
-    char* pData = (char*)&this->sData;
-    for (int i=0; i<sizeof(EEPROMStruct); i++) {
-      *pData = 0;
-      pData++;
-    }
+    LOG_WARN("eeprom data is invalid, clearing");
+    memset(&this->sData, 0, sizeof(EEPROMStruct));
   }
  
   EEPROM.end();
@@ -144,30 +289,88 @@ boolean APP_DATA::readEEpromData() {
 }
 
 /*!
- *  @brief  Reads the EEPROM data.
+ *  @brief  Stores the EEPROM data, the flash is only written if the content differs from the last commit.
+ *
+ *  ESP_EEPROM appends each commit as a new copy to its flash sector and erases the sector only when it is full,
+ *  skipping commits without changes keeps both the erase stalls and the wear down. Connection parameters are
+ *  written as of the last working connection, new ones are stored once they connected, see confirmConnection().
+ *
  *  @return True if data stored and valid, otherwise false, return true as well, if EEPROM data was equal to buffer to be stored
  */
 boolean APP_DATA::storeEEpromData() {
-  boolean ok = false;
-  if (this->sData.dataValid == EEPROM_DATA_TOSTORE) {
-    // Read EEProm and use it if present
-    EEPROM.begin(sizeof(EEPROMStruct));
-    // Check if the EEPROM contains valid data from another run
-    // If so, overwrite the 'default' values set up in our struct
-    // if(EEPROM.percentUsed()>=0) {
-    //   //EEPROM.get(0, eepromData);
-    //   Serial.println("WRITE: EEPROM has data from a previous run.");
-    //   Serial.print(EEPROM.percentUsed());
-    //   Serial.println("% of ESP flash space currently used");
-    // } else {
-    //   Serial.println("WRITE: EEPROM size changed - EEPROM data zeroed - commit() to make permanent");    
-    // }
+  boolean ok = true;
+  this->storePending = false;
+  if ((this->sData.dataValid == EEPROM_DATA_TOSTORE) || (this->sCache.dataValid == EEPROM_DATA_TOSTORE)
+      || (this->sSchedule.dataValid == EEPROM_DATA_TOSTORE) || (this->sUdp.dataValid == EEPROM_DATA_TOSTORE)) {
     this->sData.dataValid = EEPROM_DATA_VALID;
-    EEPROM.put(0, this->sData);
+    if (this->sCache.dataValid == EEPROM_DATA_TOSTORE) {
+      this->sCache.dataValid = EEPROM_DATA_VALID;
+    }
+    this->sSchedule.dataValid = EEPROM_DATA_VALID;
+    this->sUdp.dataValid = EEPROM_DATA_VALID;
+    EEPROMStruct data = this->sData;
+    copyConnection(data, this->connectedData);
+    boolean cacheValid = (getWifiCache() != nullptr);
+    boolean storedCacheValid = (this->storedCache.dataValid == EEPROM_DATA_VALID) || (this->storedCache.dataValid == EEPROM_DATA_TOSTORE);
+    if (this->storedValid && (memcmp(&data, &this->storedData, sizeof(EEPROMStruct)) == 0)
+        && (cacheValid == storedCacheValid) && (!cacheValid || sameWifiCache(this->sCache, this->storedCache))
+        && (memcmp(&this->sSchedule, &this->storedSchedule, sizeof(SCHEDULEStruct)) == 0)
+        && (memcmp(&this->sUdp, &this->storedUdp, sizeof(UDPStruct)) == 0)) {
+      LOG_DEBUG("EEProm data unchanged, nothing to store");
+      return true;
+    }
+
+    EEPROM.begin(EEPROM_SIZE);
+    EEPROM.put(0, data);
+    EEPROM.put(sizeof(EEPROMStruct), this->sCache);
+    EEPROM.put(SCHEDULE_OFFSET, this->sSchedule);
+    EEPROM.put(UDP_OFFSET, this->sUdp);
     // write the data to EEPROM
+    STATS_START(commitStart);
     ok = EEPROM.commit();
-    Serial.println((ok) ? "EEProm storing OK (in case it changed)" : "EEProm storing failed");
+    STATS_STOP(EEPROM_COMMIT, commitStart);
+    if (ok) {
+      this->storedData = data;
+      this->storedCache = this->sCache;
+      this->storedSchedule = this->sSchedule;
+      this->storedUdp = this->sUdp;
+      this->storedValid = true;
+      this->eepromCommits++;
+      LOG_INFO("EEProm storing OK, %d%% of ESP flash space currently used", EEPROM.percentUsed());
+    } else {
+      LOG_ERROR("EEProm storing failed");
+      // try again with the next request
+      this->sData.dataValid = EEPROM_DATA_TOSTORE;
+      this->sSchedule.dataValid = EEPROM_DATA_TOSTORE;
+      this->sUdp.dataValid = EEPROM_DATA_TOSTORE;
+    }
     EEPROM.end();
   }
-  return ok;;
+  return ok;
+}
+
+/*!
+ *  @brief  Copies the connection parameters, WIFI, MQTT broker, device ID and group.
+ *  @param  to    Data getting the parameters.
+ *  @param  from  Data holding the parameters.
+ */
+void APP_DATA::copyConnection(EEPROMStruct& to, const EEPROMStruct& from) {
+  memcpy(to.wifiSSID, from.wifiSSID, sizeof(to.wifiSSID));
+  memcpy(to.wifiPassword, from.wifiPassword, sizeof(to.wifiPassword));
+  to.mqttBrokerPort = from.mqttBrokerPort;
+  memcpy(to.mqttBrokerIp, from.mqttBrokerIp, sizeof(to.mqttBrokerIp));
+  memcpy(to.deviceId, from.deviceId, sizeof(to.deviceId));
+  memcpy(to.deviceGroup, from.deviceGroup, sizeof(to.deviceGroup));
+}
+
+/*!
+ *  @brief  Compares the content of two WIFI caches, dataValid and padding are ignored.
+ *  @param  a  First cache.
+ *  @param  b  Second cache.
+ *  @return True if both describe the same connection.
+ */
+boolean APP_DATA::sameWifiCache(const WIFICacheStruct& a, const WIFICacheStruct& b) {
+  return (memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0) && (a.channel == b.channel)
+      && (memcmp(a.ip, b.ip, sizeof(a.ip)) == 0) && (memcmp(a.gateway, b.gateway, sizeof(a.gateway)) == 0)
+      && (memcmp(a.subnet, b.subnet, sizeof(a.subnet)) == 0) && (memcmp(a.dns, b.dns, sizeof(a.dns)) == 0);
 }
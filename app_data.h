@@ -13,9 +13,27 @@
 #define APP_DATA_H
 
 #include <Arduino.h>
+#include "ring_buffer.h"
+#include "stats.h"
+#include "hunter_frame.h"
+#include "logger.h"
 
 #define EEPROM_DATA_VALID   0xAA
 #define EEPROM_DATA_TOSTORE 0x55
+#define EEPROM_STORE_DELAY  5000    // ms, store requests within this window are written with one commit
+
+#define HUNTER_CMD_QUEUE_SIZE 16    // watering commands waiting for the bus, power of 2
+#define HUNTER_CONTROLLERS    1     // X-Core controllers driven by this ESP, each on its own REM line
+#define HUNTER_CONTROLLERS_MAX 4    // limit of the binary command format
+#define SCHEDULE_MAX          16    // entries of the local watering schedule
+#define HUNTER_PLAN_MAX       12    // zones of a run plan
+#define HUNTER_PLAN_GAP_MAX   3600  // s between two zones of a run plan
+#define RTC_STATE_OFFSET      32    // 4 byte block of the RTC user memory, the first 128 bytes belong to the OTA boot command
+#define RTC_STATE_MAGIC       0x48554E54  // "HUNT"
+#define RTC_STATE_CMDS        16    // queued commands of all controllers kept over a reset, the oldest of each bus first
+#define UDP_COUNTER_RESERVE   256   // UDP counters reserved by one EEPROM commit
+#define DEVICE_ID_LEN         16    // device ID incl. terminator, a level of the MQTT topics, default is the chip ID
+#define DEVICE_GROUP_LEN      16    // device group incl. terminator, empty for no group
 
 /*!
  *  @brief  Enum class for data update flags.
@@ -27,8 +45,52 @@ enum class DATA_UPDATE : char {
     DHT_UPDATED             = 0x04, // 00000100
     HUNTER_ZONE_UPDATED     = 0x08, // 00001000
     HUNTER_PROGRAM_UPDATED  = 0x10, // 00010000
+    HUNTER_PLAN_UPDATED     = 0x20, // 00100000
 };
 
+/*!
+ *  @brief  Enum class for the kind of watering command.
+ */
+enum class HUNTER_CMD_TYPE : byte {
+    ZONE                    = 0,    // start or stop a zone for some time
+    PROGRAM                 = 1,    // start a program
+};
+
+/*!
+ *  @brief  Struct for a watering command waiting for the bus.
+ */
+typedef struct {
+  HUNTER_CMD_TYPE type;
+  byte            zone;       // zone 1..48, ZONE only
+  byte            time;       // minutes 0..240, 0 stops the zone, ZONE only
+  byte            program;    // program 1..4, PROGRAM only
+  byte            controller; // 0..HUNTER_CONTROLLERS-1, bus the command goes out on
+  boolean         force;      // sent even if it repeats the state of the bus
+  uint32_t        stamp;      // s since epoch the sender issued the command, 0 if unknown
+#if USE_STATS
+  uint32_t        received;   // micros() the command was received
+#endif
+} HUNTER_CMD;
+
+/*!
+ *  @brief  Struct for a step of a run plan, the frame is encoded when the plan is received.
+ */
+typedef struct {
+  HUNTER_FRAME    frame;      // zone frame for minutes
+  byte            zone;       // zone 1..48
+  byte            minutes;    // 1..240
+  uint16_t        gap;        // s to wait after the zone before the next step
+} HUNTER_PLAN_STEP;
+
+/*!
+ *  @brief  Struct for a run plan, zones are run one after the other, count 0 cancels a running plan.
+ */
+typedef struct {
+  HUNTER_PLAN_STEP  steps[HUNTER_PLAN_MAX];
+  byte              count;
+  byte              controller;   // bus of all steps
+} HUNTER_PLAN;
+
 /*!
  *  @brief  Struct for storing EEPROM data.
  */
@@ -41,8 +103,70 @@ typedef struct {
   float   dhtTempLevel;   
   int     dhtHumLevel;    
   int     dhtTemperaturOffset;   
+  char    deviceId[DEVICE_ID_LEN];
+  char    deviceGroup[DEVICE_GROUP_LEN];
 } EEPROMStruct;
 
+/*!
+ *  @brief  Struct for the WIFI fast reconnect cache, stored in EEPROM next to EEPROMStruct.
+ */
+typedef struct {
+  int     dataValid;
+  byte    bssid[6];       // access point of the last good connection
+  int32_t channel;
+  byte    ip[4];          // last DHCP lease, used as static IP if enabled
+  byte    gateway[4];
+  byte    subnet[4];
+  byte    dns[4];
+} WIFICacheStruct;
+
+/*!
+ *  @brief  Struct for an entry of the local watering schedule, runs weekly at a local time.
+ */
+typedef struct {
+  byte            days;       // bit 0 Sunday .. bit 6 Saturday, 0 for an unused entry
+  byte            hour;       // local time 0..23
+  byte            minute;     // 0..59
+  HUNTER_CMD_TYPE type;
+  byte            zone;       // zone 1..48, ZONE only
+  byte            time;       // minutes 1..240, ZONE only
+  byte            program;    // program 1..4, PROGRAM only
+  byte            controller; // 0..HUNTER_CONTROLLERS-1
+} SCHEDULE_ENTRY;
+
+/*!
+ *  @brief  Struct for the local watering schedule, stored in EEPROM behind the WIFI cache.
+ */
+typedef struct {
+  int             dataValid;
+  SCHEDULE_ENTRY  entries[SCHEDULE_MAX];
+} SCHEDULEStruct;
+
+/*!
+ *  @brief  Struct for the replay counter of the UDP listener, stored in EEPROM behind the schedule.
+ */
+typedef struct {
+  int             dataValid;
+  uint32_t        udpReserve; // every accepted counter is below it, 0 if none was accepted
+} UDPStruct;
+
+/*!
+ *  @brief  Struct for the runtime state kept in RTC user memory, it survives a reset but not a power cycle.
+ */
+typedef struct {
+  uint32_t    magic;      // RTC_STATE_MAGIC
+  uint32_t    crc;        // CRC32 of the rest of the struct
+  HUNTER_CMD  cmds[RTC_STATE_CMDS];   // commands waiting for the buses, oldest first per bus
+  uint32_t    cmdCount;
+  HUNTER_CMD  lastCmds[HUNTER_CONTROLLERS];  // last command gone out on each bus
+  uint32_t    udpCounter; // counter of the last accepted UDP datagram, below the reserve in EEPROM
+} RTCStateStruct;
+
+static_assert(HUNTER_CONTROLLERS <= HUNTER_CONTROLLERS_MAX, "too many Hunter controllers");
+
+static_assert(sizeof(RTCStateStruct) % 4 == 0, "RTC user memory is accessed in 4 byte blocks");
+static_assert(RTC_STATE_OFFSET * 4 + sizeof(RTCStateStruct) <= 512, "RTCStateStruct exceeds the RTC user memory");
+
 /*!
  *  @brief  Class for managing application data.
  */
@@ -61,14 +185,42 @@ public:
    *  @param  brokerPort  The MQTT broker port.
    */
   void initialize(const char* ssid, const char* pw, const char* brokerIP, const int brokerPort);
+  void confirmConnection();
+  boolean restoreConnection();
 
   /*!
-   *  @brief  Stores the EEPROM data.
+   *  @brief  Requests to store the EEPROM data, it is written by loop() EEPROM_STORE_DELAY ms after the first request.
    */
   void storeEEProm() {
-    this->storeEEpromData();
+    if (!storePending) {
+      storePending = true;
+      storeRequested = millis();
+    }
   };
 
+  /*!
+   *  @brief  Writes requested EEPROM data when the store delay is over, shall be called periodically.
+   */
+  void loop() {
+    if (storePending && ((millis() - storeRequested) >= EEPROM_STORE_DELAY)) {
+      this->storeEEpromData();
+    }
+  }
+
+  /*!
+   *  @brief  Writes requested EEPROM data right away, e.g. before a restart.
+   *  @return True if the data is stored or was unchanged.
+   */
+  boolean flushEEProm() {
+    return storePending ? this->storeEEpromData() : true;
+  }
+
+  /*!
+   *  @brief  Gets the number of flash commits since start.
+   *  @return The number of commits.
+   */
+  uint16_t getEEpromCommits() const { return eepromCommits; }
+
   // Getter and setter methods
 
   /*!
@@ -84,6 +236,7 @@ public:
   void setWifiSsid(const char* ssid) { 
     strncpy(sData.wifiSSID, ssid, sizeof(sData.wifiSSID)); 
     this->sData.dataValid = EEPROM_DATA_TOSTORE;
+    invalidateWifiCache();  // cache belongs to the previous network
   }
 
   /*!
@@ -114,12 +267,41 @@ public:
   void setWifiIp(const char* wifiIp) { 
     int ipPart1, ipPart2, ipPart3, ipPart4;
     if (sscanf(wifiIp, "%d.%d.%d.%d", &ipPart1, &ipPart2, &ipPart3, &ipPart4) != 4) {
-      Serial.print("invalid WIFI IP: ");
-      Serial.println(wifiIp);
+      LOG_WARN("invalid WIFI IP: %s", wifiIp);
     }
     this->wifiIp = IPAddress((byte)ipPart1, (byte)ipPart2, (byte)ipPart3, (byte)ipPart4);
   }
 
+  /*!
+   *  @brief  Gets the WIFI fast reconnect cache.
+   *  @return Pointer to the cache or nullptr if it is not valid.
+   */
+  const WIFICacheStruct* getWifiCache() const {
+    return (sCache.dataValid == EEPROM_DATA_VALID || sCache.dataValid == EEPROM_DATA_TOSTORE) ? &sCache : nullptr;
+  }
+
+  /*!
+   *  @brief  Sets the WIFI fast reconnect cache, it is marked to be stored only if the content changed.
+   *  @param  cache  The parameters of a good connection, dataValid is ignored.
+   */
+  void setWifiCache(const WIFICacheStruct& cache) {
+    if (getWifiCache() && sameWifiCache(cache, sCache)) {
+      return;
+    }
+    sCache = cache;
+    sCache.dataValid = EEPROM_DATA_TOSTORE;
+  }
+
+  /*!
+   *  @brief  Invalidates the WIFI fast reconnect cache, the next connect does a full scan and DHCP.
+   */
+  void invalidateWifiCache() {
+    if (getWifiCache()) {
+      sCache.dataValid = 0;
+      this->sData.dataValid = EEPROM_DATA_TOSTORE;   // write the invalid cache with the next store
+    }
+  }
+
   /*!
    *  @brief  Gets the MQTT broker IP address.
    *  @return The MQTT broker IP address.
@@ -136,8 +318,7 @@ public:
   void setMqttIp(const char* brokerIp) { 
     int ipPart1, ipPart2, ipPart3, ipPart4;
     if (sscanf(brokerIp, "%d.%d.%d.%d", &ipPart1, &ipPart2, &ipPart3, &ipPart4) != 4) {
-      Serial.print("invalid broker IP: ");
-      Serial.println(brokerIp);
+      LOG_WARN("invalid broker IP: %s", brokerIp);
     }
     this->sData.mqttBrokerIp[0] = (byte)ipPart1; 
     this->sData.mqttBrokerIp[1] = (byte)ipPart2; 
@@ -210,56 +391,256 @@ public:
     this->sData.dataValid = EEPROM_DATA_TOSTORE; 
   }
 
+  static boolean validDeviceName(const char* name, const size_t size);
+
   /*!
-   *  @brief  Gets the Hunter zone.
-   *  @return The Hunter zone.
+   *  @brief  Gets the device ID, it names the MQTT client and the topics of this device.
+   *  @return The device ID.
    */
-  const int getHunterZone() const { return this->hunterZone; }
+  const char* getDeviceId() const { return sData.deviceId; }
 
   /*!
-   *  @brief  Sets the Hunter zone.
-   *  @param  hunterZone  The Hunter zone.
+   *  @brief  Sets the device ID.
+   *  @param  id  The device ID, an empty ID selects the chip ID.
    */
-  void setHunterZone(const int hunterZone) { this->hunterZone = hunterZone; }
+  void setDeviceId(const char* id) {
+    strlcpy(sData.deviceId, id, sizeof(sData.deviceId));
+    if (!sData.deviceId[0]) {
+      snprintf(sData.deviceId, sizeof(sData.deviceId), "%06x", (unsigned)ESP.getChipId());
+    }
+    this->sData.dataValid = EEPROM_DATA_TOSTORE;
+  }
 
   /*!
-   *  @brief  Gets the Hunter time.
-   *  @return The Hunter time.
+   *  @brief  Gets the device group, commands to the group reach all of its devices.
+   *  @return The device group, empty if the device is in no group.
    */
-  const int getHunterTime() const { return this->hunterTime; }
+  const char* getDeviceGroup() const { return sData.deviceGroup; }
+
+  /*!
+   *  @brief  Sets the device group.
+   *  @param  group  The device group, empty to leave the group.
+   */
+  void setDeviceGroup(const char* group) {
+    strlcpy(sData.deviceGroup, group, sizeof(sData.deviceGroup));
+    this->sData.dataValid = EEPROM_DATA_TOSTORE;
+  }
 
   /*!
-   *  @brief  Sets the Hunter time.
-   *  @param  hunterTime  The Hunter time.
+   *  @brief  Queues a watering command for the Hunter bus of its controller.
+   *  @param  cmd  The command.
+   *  @return True if queued, false if the queue is full or the controller unknown and the command is dropped.
    */
-  void setHunterTime(const int hunterTime) { this->hunterTime = hunterTime; }
+  boolean pushHunterCmd(const HUNTER_CMD& cmd) {
+    if (cmd.controller >= HUNTER_CONTROLLERS) {
+      return false;
+    }
+    if (!hunterCmds[cmd.controller].push(cmd)) {
+      hunterCmdOverflows[cmd.controller]++;
+      return false;
+    }
+    runtimeVersion++;
+    return true;
+  }
+
+  /*!
+   *  @brief  Takes the oldest watering command of a controller from its queue.
+   *  @param  controller  The controller of the bus.
+   *  @param  cmd         Receives the command.
+   *  @return True if a command was taken, false if the queue is empty.
+   */
+  boolean popHunterCmd(const byte controller, HUNTER_CMD& cmd) {
+    if ((controller >= HUNTER_CONTROLLERS) || !hunterCmds[controller].pop(cmd)) {
+      return false;
+    }
+    runtimeVersion++;
+    return true;
+  }
 
   /*!
-   *  @brief  Gets the Hunter program.
-   *  @return The Hunter program.
+   *  @brief  Gets the number of queued watering commands of all controllers.
+   *  @return The number of commands waiting for a bus.
    */
-  const int getHunterProgram() const { return this->hunterProgram; }
+  uint16_t getHunterCmdCount() const {
+    uint16_t count = 0;
+    for (byte i = 0; i < HUNTER_CONTROLLERS; i++) {
+      count += hunterCmds[i].size();
+    }
+    return count;
+  }
+
+  /*!
+   *  @brief  Gets the number of queued watering commands of a controller.
+   *  @param  controller  The controller of the bus.
+   *  @return The number of commands waiting for its bus.
+   */
+  uint16_t getHunterCmdCount(const byte controller) const {
+    return (controller < HUNTER_CONTROLLERS) ? hunterCmds[controller].size() : 0;
+  }
+
+  /*!
+   *  @brief  Sets the last command gone out on the bus of its controller, it is kept over a reset.
+   *  @param  cmd  The command.
+   */
+  void setLastHunterCmd(const HUNTER_CMD& cmd) {
+    if (cmd.controller < HUNTER_CONTROLLERS) {
+      lastHunterCmds[cmd.controller] = cmd;
+      runtimeVersion++;
+    }
+  }
+
+  /*!
+   *  @brief  Gets the last command gone out on the bus of a controller.
+   *  @param  controller  The controller of the bus.
+   *  @return The command, all zero if none was sent.
+   */
+  const HUNTER_CMD& getLastHunterCmd(const byte controller) const { return lastHunterCmds[controller % HUNTER_CONTROLLERS]; }
+
+  /*!
+   *  @brief  Gets the number of watering commands of a controller dropped since start, because its queue was full.
+   *  @param  controller  The controller of the bus.
+   *  @return The number of dropped commands.
+   */
+  uint16_t getHunterCmdOverflows(const byte controller) const { return hunterCmdOverflows[controller % HUNTER_CONTROLLERS]; }
+
+  /*!
+   *  @brief  Gets the latest run plan of a controller.
+   *  @param  controller  The controller of the bus.
+   *  @return The plan, HUNTER_CTRL runs it once per version.
+   */
+  const HUNTER_PLAN& getHunterPlan(const byte controller) const { return hunterPlans[controller % HUNTER_CONTROLLERS]; }
+
+  /*!
+   *  @brief  Sets a new run plan of its controller, it replaces the plan running there, other controllers go on.
+   *  @param  plan  The validated and encoded plan.
+   *  @return True if set, false if the controller is unknown.
+   */
+  boolean setHunterPlan(const HUNTER_PLAN& plan) {
+    if (plan.controller >= HUNTER_CONTROLLERS) {
+      return false;
+    }
+    hunterPlans[plan.controller] = plan;
+    hunterPlanVersions[plan.controller]++;
+    return true;
+  }
+
+  /*!
+   *  @brief  Gets the version of the run plan of a controller, it changes with every plan set for it.
+   *  @param  controller  The controller of the bus.
+   *  @return The version.
+   */
+  uint16_t getHunterPlanVersion(const byte controller) const { return hunterPlanVersions[controller % HUNTER_CONTROLLERS]; }
+
+  /*!
+   *  @brief  Gets an entry of the local watering schedule.
+   *  @param  slot  Index of the entry, 0..SCHEDULE_MAX-1.
+   *  @return The entry, days is 0 for an unused entry.
+   */
+  const SCHEDULE_ENTRY& getScheduleEntry(const byte slot) const { return sSchedule.entries[slot % SCHEDULE_MAX]; }
+
+  /*!
+   *  @brief  Sets an entry of the local watering schedule, the caller validates its content.
+   *  @param  slot   Index of the entry, 0..SCHEDULE_MAX-1.
+   *  @param  entry  The entry, days 0 clears it.
+   *  @return True if set, false if the slot is invalid.
+   */
+  boolean setScheduleEntry(const byte slot, const SCHEDULE_ENTRY& entry) {
+    if (slot >= SCHEDULE_MAX) {
+      return false;
+    }
+    sSchedule.entries[slot] = entry;
+    sSchedule.dataValid = EEPROM_DATA_TOSTORE;
+    scheduleVersion++;
+    return true;
+  }
+
+  /*!
+   *  @brief  Gets the version of the schedule, it changes with every set entry.
+   *  @return The version.
+   */
+  uint16_t getScheduleVersion() const { return scheduleVersion; }
+
+  /*!
+   *  @brief  Gets the counter a UDP datagram has to be above to be accepted.
+   *
+   *  After a reset it is the last accepted counter kept in RTC memory, after a power cycle the reserve in EEPROM.
+   *
+   *  @return The counter, 0 if no datagram has been accepted.
+   */
+  uint32_t getUdpCounter() const { return udpCounter; }
+
+  /*!
+   *  @brief  Takes the counter of an accepted UDP datagram, it never goes down.
+   *
+   *  It is written to RTC memory right away. The EEPROM holds a reserve above all accepted counters, it is
+   *  raised by UDP_COUNTER_RESERVE and committed before a counter reaches it, so a power cycle does not open
+   *  a replay window and the flash is written once per UDP_COUNTER_RESERVE datagrams.
+   *
+   *  @param  counter  The counter, above getUdpCounter().
+   *  @return True if the counter is taken, false if it is not above or the reserve could not be committed.
+   */
+  boolean setUdpCounter(const uint32_t counter) {
+    if (counter <= udpCounter) {
+      return false;
+    }
+    if (counter >= sUdp.udpReserve) {
+      sUdp.udpReserve = (counter < UINT32_MAX - UDP_COUNTER_RESERVE) ? counter + UDP_COUNTER_RESERVE : UINT32_MAX;
+      sUdp.dataValid = EEPROM_DATA_TOSTORE;
+      storeEEProm();
+      if (!flushEEProm()) {
+        return false;
+      }
+    }
+    udpCounter = counter;
+    runtimeVersion++;
+    saveRuntimeState();
+    return true;
+  }
 
   /*!
-   *  @brief  Sets the Hunter program.
-   *  @param  hunterProgram  The Hunter program.
+   *  @brief  Gets the version of the runtime state, it changes with every queued or taken command.
+   *  @return The version.
    */
-  void setHunterProgram(const int hunterProgram) { this->hunterProgram = hunterProgram; }
+  uint16_t getRuntimeVersion() const { return runtimeVersion; }
+  void    saveRuntimeState();
+  boolean restoreRuntimeState();
   void setNewDataFlag(DATA_UPDATE dataUpdate);
   DATA_UPDATE getNewDataFlag();
   void clearNewDataFlag(DATA_UPDATE dataUpdate);
 
 
 private:
-  EEPROMStruct  sData;
+  EEPROMStruct    sData;
+  WIFICacheStruct sCache;
+  SCHEDULEStruct  sSchedule;
+  UDPStruct       sUdp;
+  uint32_t        udpCounter = 0;     // last accepted UDP counter, see getUdpCounter()
+  uint16_t      scheduleVersion = 0;
   IPAddress     brokerIp;
   IPAddress     wifiIp;
-  int           hunterZone;
-  int           hunterTime;
-  int           hunterProgram;
+  RING_BUFFER<HUNTER_CMD, HUNTER_CMD_QUEUE_SIZE> hunterCmds[HUNTER_CONTROLLERS];
+  HUNTER_CMD    lastHunterCmds[HUNTER_CONTROLLERS] = {};
+  uint16_t      hunterCmdOverflows[HUNTER_CONTROLLERS] = {};
+  HUNTER_PLAN   hunterPlans[HUNTER_CONTROLLERS] = {};
+  uint16_t      hunterPlanVersions[HUNTER_CONTROLLERS] = {};
+  uint16_t      runtimeVersion = 0;
+  uint16_t      savedRuntimeVersion = 0;    // runtime version last written to RTC memory
+
+  // image of the data last read from or committed to flash, a store without changes is skipped
+  EEPROMStruct    storedData;
+  WIFICacheStruct storedCache;
+  SCHEDULEStruct  storedSchedule;
+  UDPStruct       storedUdp;
+  boolean       storedValid = false;
+  EEPROMStruct    connectedData;      // data of the last working connection, only its connection parameters are stored
+  boolean       storePending = false;
+  uint32_t      storeRequested = 0;   // millis() of the first pending store request
+  uint16_t      eepromCommits = 0;
 
   boolean       readEEpromData();
   boolean       storeEEpromData();
+  static boolean sameWifiCache(const WIFICacheStruct& a, const WIFICacheStruct& b);
+  static void   copyConnection(EEPROMStruct& to, const EEPROMStruct& from);
 
   DATA_UPDATE   dataUpdate;
 };
@@ -34,6 +34,8 @@ void DHT_SENSOR::initialize(OLED* oled, APP_DATA* appData) {
   temp_lastRead = temp_actual = 0;
   humidity_lastRead = humidity_actual = 0; 
   timeSinceLastRead = 0;   
+  sampleCount = sampleIndex = 0;
+  outliers = 0;
 
   dht.begin(DEFAULT_DHT_PULLUP_TIME);  
 
@@ -67,49 +69,88 @@ const float DHT_SENSOR::getHumidity() {
 }
 
 /*!
- *  @brief  Checks if new data is available.
- *          Reads value from sensor if less than MIN_INTERVAL.
- *          Checks if change is greater than level for temp or humidity.
- *  @return True if new data is available, false otherwise.
+ *  @brief  Reads the sensor once per MIN_INTERVAL and filters the values.
+ *
+ *  A read is one blocking transaction with interrupts disabled for a few ms, the caller has to make sure
+ *  it does not run while a frame goes out on the Hunter bus. Temperature and humidity are taken from the
+ *  same transaction, samples out of the sensor range are dropped and the median of the last DHT_FILTER_LEN
+ *  samples is compared against the levels in appData. newDataAvailable() reports a change greater than a level.
+ *
+ *  @return True if a valid sample was taken, false if MIN_INTERVAL has not passed or the read failed.
  */
-const bool DHT_SENSOR::newDataAvailable() {
-  boolean newData = false;
+boolean DHT_SENSOR::sample() {
+  if (millis() - timeSinceLastRead < MIN_INTERVAL) {
+    return false;
+  }
+  // one transaction, the conversions below use its data
+  timeSinceLastRead = millis();
+  boolean ok = dht.read(true);
+  if (!ok) {
+    return false;  // Read failed somehow, try again with the next period
+  }
+  float h = dht.readHumidity();
+  // Read temperature as Celsius
+  float t = dht.readTemperature();
 
-  if (millis() - timeSinceLastRead > MIN_INTERVAL) {
-    float h = dht.readHumidity();
-    // Read temperature as Celsius
-    float t = dht.readTemperature();
-    // Read temperature as Fahrenheit
-    float f = dht.readTemperature(true);
-    timeSinceLastRead = millis();
+  // Check if any reads failed or are out of range and exit early (to try again).
+  if (isnan(h) || isnan(t) || (t < DHT_TEMP_MIN) || (t > DHT_TEMP_MAX) || (h < DHT_HUM_MIN) || (h > DHT_HUM_MAX)) {
+    outliers++;
+    return false;
+  }
+  tempSamples[sampleIndex] = t;
+  humSamples[sampleIndex] = h;
+  sampleIndex = (sampleIndex + 1) % DHT_FILTER_LEN;
+  if (sampleCount < DHT_FILTER_LEN) {
+    sampleCount++;
+  }
 
-    // Check if any reads failed and exit early (to try again).
-    if (isnan(h) || isnan(t) || isnan(f)){      
-      return false;  // Read failed somehow
+  // a single spike does not reach the median
+  temp_actual = median(tempSamples, sampleCount);
+  if (appData) {
+    temp_actual = temp_actual + appData->getDhtTempOffset();
+  }
+  humidity_actual = median(humSamples, sampleCount);
+
+  if (appData) {
+    float diff = temp_actual - temp_lastRead;
+    if (abs(diff) >= appData->getDhtTempLevel()) {
+      newData = true;
     }
-    
-    temp_actual = t;
-    if (appData) {
-      temp_actual = t + appData->getDhtTempOffset();
+
+    diff = humidity_actual - humidity_lastRead;
+    if (abs(diff) >= appData->getDhtHumLevel()) {
+      newData = true;
     }
-    humidity_actual = h;
+  }
+  // Set display values
+  if (oled) {
+    oled->updateDHT(temp_actual, humidity_actual);   
+  }
+  return true;
+}
 
-    if (appData) {
-      float diff = temp_actual - temp_lastRead;
-      if (abs(diff) >= appData->getDhtTempLevel()) {
-        newData = true;
-      }
+// ======= private functions ===================================================
 
-      diff = humidity_actual - humidity_lastRead;
-      if (abs(diff) >= appData->getDhtHumLevel()) {
-        newData = true;
-      }
-    }
-    // Set display values
-    if (oled) {
-      oled->updateDHT(temp_actual, humidity_actual);   
+/*!
+ *  @brief  Gets the median of some samples.
+ *  @param  samples  The samples, order does not matter.
+ *  @param  count    Number of samples, 1..DHT_FILTER_LEN.
+ *  @return The median, for an even count the mean of both middle values.
+ */
+float DHT_SENSOR::median(const float* samples, const uint8_t count) {
+  float sorted[DHT_FILTER_LEN];
+  // insertion sort, a handful of values only
+  for (uint8_t i = 0; i < count; i++) {
+    float value = samples[i];
+    uint8_t j = i;
+    while ((j > 0) && (sorted[j - 1] > value)) {
+      sorted[j] = sorted[j - 1];
+      j--;
     }
-
-  } 
-  return newData;
+    sorted[j] = value;
+  }
+  if (count % 2) {
+    return sorted[count / 2];
+  }
+  return (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
 }
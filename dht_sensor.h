@@ -22,6 +22,11 @@
                                            reading starts. Default is 55 (see function declaration in DHT.h) */
 
 #define MIN_INTERVAL 2000 /**< min interval value in ms between reads of the sensor */
+#define DHT_FILTER_LEN  5     /**< number of samples in the median filter, odd */
+#define DHT_TEMP_MIN    -40   /**< samples outside of the sensor range are dropped as outliers */
+#define DHT_TEMP_MAX    80
+#define DHT_HUM_MIN     0
+#define DHT_HUM_MAX     100
 
 /*!
  *  @brief  Class that stores state and functions for DHT
@@ -32,7 +37,11 @@ public:
   DHT_SENSOR(): oled(nullptr), appData(nullptr), dht(DHTPIN, DHTTYPE) {};
   // public methods
   void initialize(OLED* oled, APP_DATA* appData);
-  const bool newDataAvailable();
+  boolean sample();
+  const bool newDataAvailable() const { return newData; }
+  uint16_t getOutliers() const { return outliers; }
+  float   getFilteredTemperature() const { return temp_actual; }
+  float   getFilteredHumidity() const { return humidity_actual; }
   const float getTemperature();
   const float getHumidity();
   void updateDisplay();
@@ -44,6 +53,12 @@ private:
   float     newDataLevelTemp;          // R/W, which change in value triggers new data
   float     newDataLevelHum;           // R/W, which change in value triggers new data
   long      timeSinceLastRead;
+  float     tempSamples[DHT_FILTER_LEN];  // raw samples, oldest is overwritten
+  float     humSamples[DHT_FILTER_LEN];
+  uint8_t   sampleCount;                  // valid samples, up to DHT_FILTER_LEN
+  uint8_t   sampleIndex;                  // next sample to overwrite
+  uint16_t  outliers;                     // dropped samples since start
+  static float median(const float* samples, const uint8_t count);
   uint8_t   _pin, _type;
   DHT       dht;
   OLED*     oled;
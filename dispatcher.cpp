@@ -0,0 +1,71 @@
+/*!
+ *  @file dispatcher.cpp
+ *
+ *  @mainpage  dispatcher for data updates in a HUNTER XCORE watering application.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  Data updates are signaled by bits in the DATA_UPDATE flag of APP_DATA, typically set
+ *  by a received MQTT subscription. More than one bit can be set at a time, the dispatcher
+ *  calls the registered handler of every set bit in one go, in priority order.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "dispatcher.h"
+#include "logger.h"
+
+/*!
+ * @brief initalizes the DISPATCHER class
+ *
+ * @param appData   pointer to APP_DATA class, holding the DATA_UPDATE flags
+ */
+void DISPATCHER::initialize(APP_DATA* appData) {
+  this->appData = appData;
+}
+
+/*!
+ * @brief registers a handler for a DATA_UPDATE flag
+ *
+ * handlers are called in the order of registration
+ *
+ * @param flag      flag to handle, a single bit
+ * @param handler   function to call while the flag is set
+ *
+ * @return success or failure if too many handlers are registered
+ */
+boolean DISPATCHER::registerHandler(DATA_UPDATE flag, DATA_HANDLER handler) {
+  if ((count >= MAX_HANDLERS) || (handler == nullptr)) {
+    LOG_ERROR("dispatcher handler not registered");
+    return false;
+  }
+  entries[count].flag = flag;
+  entries[count].handler = handler;
+  count++;
+  return true;
+}
+
+/*!
+ * @brief calls the handler of every pending flag and clears the flags of finished updates
+ *
+ * shall be called once per main loop iteration
+ */
+void DISPATCHER::dispatch() {
+  if (!appData) {
+    return;
+  }
+  for (byte i = 0; i < count; i++) {
+    // read flags again, a handler may have set further flags
+    if ((byte)appData->getNewDataFlag() & (byte)entries[i].flag) {
+      if (entries[i].handler(entries[i].flag)) {
+        appData->clearNewDataFlag(entries[i].flag);
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+/*!
+ *  @file dispatcher.h
+ *
+ *  This is a dispatcher calling registered handlers for all pending DATA_UPDATE flags.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <Arduino.h>
+#include "app_data.h"
+
+#define MAX_HANDLERS  8     // one handler per DATA_UPDATE bit
+
+/*!
+ *  @brief  Handler for a DATA_UPDATE flag.
+ *  @param  flag  The flag the handler is called for.
+ *  @return True if the update is done and the flag shall be cleared, false to keep it pending.
+ */
+typedef boolean (*DATA_HANDLER)(DATA_UPDATE flag);
+
+/*!
+ *  @brief  Class that walks all set DATA_UPDATE flags in priority order.
+ *
+ *  Handlers are called in the order of registration, register the most urgent first.
+ *  Each flag is checked right before its handler is called, so a flag set by a handler
+ *  with higher priority is handled in the same dispatch.
+ */
+class DISPATCHER {
+public:
+  // constructor
+  DISPATCHER() : count(0) {};
+  // public methods
+  void    initialize(APP_DATA* appData);
+  boolean registerHandler(DATA_UPDATE flag, DATA_HANDLER handler);
+  void    dispatch();
+
+private:
+  typedef struct {
+    DATA_UPDATE   flag;
+    DATA_HANDLER  handler;
+  } HANDLER_ENTRY;
+
+  HANDLER_ENTRY entries[MAX_HANDLERS];
+  byte          count;
+  APP_DATA*     appData;
+};
+
+#endif // DISPATCHER_H
@@ -0,0 +1,113 @@
+/*!
+ *  @file fixed_string.h
+ *
+ *  This is a fixed-capacity string with bounded formatting, it never touches the heap.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <IPAddress.h>
+
+/*!
+ *  @brief  Template class for a zero terminated string of at most N-1 characters.
+ *
+ *  Text beyond the capacity is cut off and flagged as truncated, the string itself
+ *  stays valid. It lives on the stack or in a static object like a plain char array.
+ */
+template <size_t N>
+class FIXED_STRING {
+  static_assert(N > 1, "FIXED_STRING needs room for one character and the terminator");
+
+public:
+  // constructor
+  FIXED_STRING() : len(0), truncation(false) { buffer[0] = '\0'; };
+  explicit FIXED_STRING(const char* text) : FIXED_STRING() { append(text); };
+
+  /*!
+   *  @brief  Appends a text.
+   *  @param  text  The text, nullptr appends nothing.
+   *  @return The string itself for chaining.
+   */
+  FIXED_STRING& append(const char* text) {
+    while (text && *text) {
+      if (len >= N - 1) {
+        truncation = true;
+        break;
+      }
+      buffer[len++] = *text++;
+    }
+    buffer[len] = '\0';
+    return *this;
+  }
+
+  /*!
+   *  @brief  Appends an integer in decimal.
+   *  @param  value  The value.
+   *  @return The string itself for chaining.
+   */
+  FIXED_STRING& append(const long value) {
+    return format("%ld", value);
+  }
+
+  /*!
+   *  @brief  Appends formatted text, bounded like snprintf.
+   *  @param  fmt  printf format.
+   *  @return The string itself for chaining.
+   */
+  __attribute__((format(printf, 2, 3))) FIXED_STRING& format(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buffer + len, N - len, fmt, args);
+    va_end(args);
+    if (written < 0) {
+      buffer[len] = '\0';
+    } else if ((size_t)written >= N - len) {
+      len = N - 1;
+      truncation = true;
+    } else {
+      len += written;
+    }
+    return *this;
+  }
+
+  /*!
+   *  @brief  Empties the string.
+   */
+  void clear() {
+    len = 0;
+    truncation = false;
+    buffer[0] = '\0';
+  }
+
+  const char* c_str() const     { return buffer; }
+  size_t      length() const    { return len; }
+  boolean     truncated() const { return truncation; }
+  static constexpr size_t capacity() { return N - 1; }
+
+private:
+  char    buffer[N];
+  size_t  len;
+  boolean truncation;
+};
+
+typedef FIXED_STRING<16> IP_STRING;   // "255.255.255.255"
+
+/*!
+ *  @brief  Formats an IP address in dotted decimal, the heap free counterpart of IPAddress::toString().
+ *  @param  ip  The address.
+ *  @return The address as text.
+ */
+inline IP_STRING ipString(const IPAddress& ip) {
+  IP_STRING text;
+  text.format("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return text;
+}
+
+#endif // FIXED_STRING_H
@@ -0,0 +1,229 @@
+/*!
+ *  @file history.cpp
+ *
+ *  @mainpage  fixed-memory history of the DHT values.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  Every DHT sample is added to the running slot, a slot of HISTORY_SLOT ms is averaged into one point.
+ *  The points are kept as 16 bit fixed-point values in a ring buffer of HISTORY_LEN points, which covers
+ *  about one day without any dynamic memory. Every HISTORY_PUBLISH_INTERVAL ms the points not published yet
+ *  are sent as one message on PRE_MQTT/history together with min/max/avg of the last hour and of the
+ *  whole history. A backlog after a broker outage is sent in batches of HISTORY_BATCH_MAX points.
+ *    {
+ *      "slot": 360,              // s per point
+ *      "scale": 10,              // values are integers in 1/scale units
+ *      "seq": 1234,              // number of the first point since start
+ *      "uptime": 444444,         // s since start when the message was built
+ *      "temp": [215, 216, null], // oldest first, null for a slot without samples
+ *      "hum":  [553, 550, null],
+ *      "hour": { "temp": [min, max, avg], "hum": [min, max, avg] },
+ *      "day":  { "temp": [min, max, avg], "hum": [min, max, avg] }
+ *    }
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "history.h"
+#include "logger.h"
+
+/*!
+ * @brief initalizes the HISTORY class, the first slot starts right away
+ *
+ * @param mqtt  pointer to MQTT class used to publish the history
+ */
+void HISTORY::initialize(MQTT* mqtt) {
+  this->mqtt = mqtt;
+  points.clear();
+  slotStart = millis();
+  lastPublish = millis();
+  tempSum = humSum = 0;
+  slotSamples = 0;
+  slotCount = 0;
+  unsent = 0;
+}
+
+/*!
+ * @brief adds a filtered DHT sample to the running slot
+ *
+ * @param temp      temperature in °C
+ * @param humidity  humidity in %
+ */
+void HISTORY::addSample(const float temp, const float humidity) {
+  tempSum += lroundf(temp * HISTORY_SCALE);
+  humSum += lroundf(humidity * HISTORY_SCALE);
+  slotSamples++;
+}
+
+/*!
+ * @brief loop called periodically, closes the running slot and publishes when due
+ */
+void HISTORY::loop() {
+  if (millis() - slotStart >= HISTORY_SLOT) {
+    closeSlot();
+  }
+  if (!unsent || !mqtt || (mqtt->getState() != MQTT_STATE::BROKER_CONNECTED)) {
+    return;
+  }
+  // a backlog is sent right away, batch by batch
+  if ((unsent > HISTORY_BATCH_MAX) || (millis() - lastPublish >= publishInterval)) {
+    publish();
+  }
+}
+
+/*!
+ * @brief gets min, max and average temperature of the newest points
+ *
+ * @param window  number of points, the whole history if larger than getSize()
+ *
+ * @return the statistics in 0.1 °C
+ */
+HISTORY_STATS HISTORY::getTempStats(const uint16_t window) const {
+  return stats(window, false);
+}
+
+/*!
+ * @brief gets min, max and average humidity of the newest points
+ *
+ * @param window  number of points, the whole history if larger than getSize()
+ *
+ * @return the statistics in 0.1 %
+ */
+HISTORY_STATS HISTORY::getHumStats(const uint16_t window) const {
+  return stats(window, true);
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief averages the running slot into a point, the oldest point is dropped if the history is full
+ */
+void HISTORY::closeSlot() {
+  HISTORY_POINT point = { HISTORY_NO_VALUE, HISTORY_NO_VALUE };
+  if (slotSamples) {
+    point.temp = (int16_t)(tempSum / slotSamples);
+    point.humidity = (int16_t)(humSum / slotSamples);
+  }
+  if (points.full()) {
+    HISTORY_POINT dropped;
+    points.pop(dropped);
+  }
+  points.push(point);
+  slotCount++;
+  if (unsent < points.size()) {
+    unsent++;
+  }
+
+  tempSum = humSum = 0;
+  slotSamples = 0;
+  slotStart += HISTORY_SLOT;
+}
+
+/*!
+ * @brief publishes the oldest unsent points, at most HISTORY_BATCH_MAX
+ *
+ * @return success or failure, the points are sent again with the next attempt on failure
+ */
+boolean HISTORY::publish() {
+  uint16_t count = (unsent > HISTORY_BATCH_MAX) ? HISTORY_BATCH_MAX : unsent;
+  uint16_t first = points.size() - unsent;
+
+  JSON_WRITER json = mqtt->payloadWriter();
+  json.beginObject()
+        .add("slot", (int)(HISTORY_SLOT / 1000))
+        .add("scale", HISTORY_SCALE)
+        .add("seq", (int)(slotCount - unsent))
+        .add("uptime", (int)(millis() / 1000));
+  json.beginArray("temp");
+  for (uint16_t i = first; i < first + count; i++) {
+    if (points.at(i).temp == HISTORY_NO_VALUE) {
+      json.null();
+    } else {
+      json.value(points.at(i).temp);
+    }
+  }
+  json.endArray();
+  json.beginArray("hum");
+  for (uint16_t i = first; i < first + count; i++) {
+    if (points.at(i).humidity == HISTORY_NO_VALUE) {
+      json.null();
+    } else {
+      json.value(points.at(i).humidity);
+    }
+  }
+  json.endArray();
+  writeStats(json, "hour", HISTORY_WINDOW);
+  writeStats(json, "day", HISTORY_LEN);
+  json.endObject();
+
+  lastPublish = millis();
+  LOG_DEBUG("Publishing history");
+  if (!mqtt->publish(MQTT_TOPIC::HISTORY, json)) {
+    return false;
+  }
+  unsent -= count;
+  return true;
+}
+
+/*!
+ * @brief computes min, max and average of the newest points, slots without samples are skipped
+ *
+ * @param window    number of points
+ * @param humidity  true for humidity, false for temperature
+ *
+ * @return the statistics
+ */
+HISTORY_STATS HISTORY::stats(const uint16_t window, const boolean humidity) const {
+  HISTORY_STATS result = { INT16_MAX, INT16_MIN, 0, 0 };
+  uint16_t size = points.size();
+  uint16_t first = (window < size) ? size - window : 0;
+  int32_t sum = 0;
+  for (uint16_t i = first; i < size; i++) {
+    int16_t value = humidity ? points.at(i).humidity : points.at(i).temp;
+    if (value == HISTORY_NO_VALUE) {
+      continue;
+    }
+    if (value < result.min) {
+      result.min = value;
+    }
+    if (value > result.max) {
+      result.max = value;
+    }
+    sum += value;
+    result.count++;
+  }
+  if (result.count) {
+    result.avg = (int16_t)(sum / result.count);
+  }
+  return result;
+}
+
+/*!
+ * @brief writes min, max and average of temperature and humidity as an object
+ *
+ * @param json    the writer
+ * @param key     member name of the object
+ * @param window  number of points
+ */
+void HISTORY::writeStats(JSON_WRITER& json, const char* key, const uint16_t window) const {
+  json.beginObject(key);
+  for (byte i = 0; i < 2; i++) {
+    HISTORY_STATS s = stats(window, i == 1);
+    if (s.count) {
+      json.beginArray((i == 1) ? "hum" : "temp")
+            .value(s.min)
+            .value(s.max)
+            .value(s.avg)
+          .endArray();
+    } else {
+      json.add((i == 1) ? "hum" : "temp", (const char*)nullptr);
+    }
+  }
+  json.endObject();
+}
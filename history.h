@@ -0,0 +1,75 @@
+/*!
+ *  @file history.h
+ *
+ *  This is a class keeping a fixed-size history of the DHT values.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+#include "mqtt.h"
+
+#define HISTORY_LEN               256       // points kept, power of 2, 4 bytes each
+#define HISTORY_SLOT              360000UL  // ms averaged into one point, 256 points cover 25.6 hours
+#define HISTORY_PUBLISH_INTERVAL  3600000UL // ms between two history messages
+#define HISTORY_BATCH_MAX         16        // points per message, a longer backlog is sent in several messages
+#define HISTORY_WINDOW            10        // points in the short rolling window, 1 hour with HISTORY_SLOT
+#define HISTORY_SCALE             10        // fixed-point factor, values are stored in 0.1 units
+#define HISTORY_NO_VALUE          INT16_MIN // point of a slot without samples
+
+/*!
+ *  @brief  Struct for one point of the history, average of one slot in fixed-point.
+ */
+typedef struct {
+  int16_t   temp;       // 0.1 °C
+  int16_t   humidity;   // 0.1 %
+} HISTORY_POINT;
+
+/*!
+ *  @brief  Struct for min, max and average over a window of points.
+ */
+typedef struct {
+  int16_t   min;
+  int16_t   max;
+  int16_t   avg;
+  uint16_t  count;      // points with a value, min/max/avg are invalid if 0
+} HISTORY_STATS;
+
+class HISTORY {
+public:
+  // constructor
+  HISTORY() : mqtt(nullptr), slotStart(0), tempSum(0), humSum(0), slotSamples(0), slotCount(0),
+              unsent(0), publishInterval(HISTORY_PUBLISH_INTERVAL), lastPublish(0) {};
+  // public methods
+  void    initialize(MQTT* mqtt);
+  void    addSample(const float temp, const float humidity);
+  void    setPublishInterval(const uint32_t interval) { publishInterval = interval; }
+  HISTORY_STATS getTempStats(const uint16_t window) const;
+  HISTORY_STATS getHumStats(const uint16_t window) const;
+  uint16_t getSize() const { return points.size(); }
+  void    loop();
+
+private:
+  void    closeSlot();
+  boolean publish();
+  HISTORY_STATS stats(const uint16_t window, const boolean humidity) const;
+  void    writeStats(JSON_WRITER& json, const char* key, const uint16_t window) const;
+  MQTT*     mqtt;
+  RING_BUFFER<HISTORY_POINT, HISTORY_LEN> points;
+  uint32_t  slotStart;        // millis() of the start of the running slot
+  int32_t   tempSum;          // samples of the running slot, in 0.1 units
+  int32_t   humSum;
+  uint16_t  slotSamples;
+  uint32_t  slotCount;        // slots closed since start, number of the newest point + 1
+  uint16_t  unsent;           // newest points not published yet
+  uint32_t  publishInterval;
+  uint32_t  lastPublish;      // millis() of the last history message
+};
+
+#endif // HISTORY_H
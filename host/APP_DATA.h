@@ -0,0 +1,2 @@
+// the sources include APP_DATA.h, the file is app_data.h
+#include "../app_data.h"
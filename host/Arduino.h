@@ -0,0 +1,114 @@
+/*!
+ *  @file Arduino.h
+ *
+ *  Host stand-in for the parts of the ESP8266 Arduino core used by the modules of the host build.
+ *  Time comes from the host clock, the ESP and Serial calls do nothing, nothing in here allocates.
+ *  timer1 runs on a simulated clock, hostTimer1Expire() calls its ISR, digitalWrite() records
+ *  every edge with the time of that clock.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH    1
+#define LOW     0
+#define OUTPUT  1
+#define INPUT   0
+#define IRAM_ATTR
+#define PROGMEM
+
+static const uint8_t D0 = 16, D1 = 5, D2 = 4, D3 = 0, D4 = 2, D5 = 14, D6 = 12, D7 = 13, D8 = 15;
+
+#define TIM_DIV1    0     // 80 MHz
+#define TIM_DIV16   1     // 5 MHz
+#define TIM_DIV256  3     // 312.5 kHz
+#define TIM_EDGE    0
+#define TIM_SINGLE  0
+#define TIM_LOOP    1
+
+#define HOST_MAX_EDGES  512   // edges recorded by digitalWrite()
+
+typedef void (*timercallback)(void);
+
+/*!
+ *  @brief  Struct for an edge driven by digitalWrite().
+ */
+typedef struct {
+  uint8_t   pin;
+  uint8_t   level;
+  uint32_t  at;       // us of the timer1 clock
+} HOST_EDGE;
+
+extern HOST_EDGE hostEdges[HOST_MAX_EDGES];
+extern size_t    hostEdgeCount;   // edges recorded, the ones beyond HOST_MAX_EDGES are counted only
+
+inline void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t val);
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_write(uint32_t ticks);
+void timer1_disable();
+bool hostTimer1Expire();
+inline void interrupts() {}
+inline void noInterrupts() {}
+inline void yield() {}
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+long secureRandom(long howbig);
+
+inline char* ltoa(long value, char* s, int) { sprintf(s, "%ld", value); return s; }
+inline char* ultoa(unsigned long value, char* s, int) { sprintf(s, "%lu", value); return s; }
+inline char* dtostrf(double value, signed char width, unsigned char prec, char* s) {
+  sprintf(s, "%*.*f", width, prec, value);
+  return s;
+}
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = (len < size - 1) ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+#endif
+
+class HardwareSerial {
+public:
+  int     availableForWrite() { return 128; }
+  size_t  write(const uint8_t*, size_t length) { return length; }
+  size_t  write(uint8_t) { return 1; }
+  size_t  print(const char* text) { return strlen(text); }
+  void    flush() {}
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getChipId() { return 0x123456; }
+  uint32_t getFreeHeap() { return 40000; }
+  uint32_t getMaxFreeBlockSize() { return 30000; }
+  bool     rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+  bool     rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+};
+extern EspClass ESP;
+
+#endif // HOST_ARDUINO_H
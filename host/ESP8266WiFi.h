@@ -0,0 +1,29 @@
+/*!
+ *  @file ESP8266WiFi.h
+ *
+ *  Host stand-in for the WIFI classes used by MQTT, the station is always connected.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HOST_ESP8266WIFI_H
+#define HOST_ESP8266WIFI_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiClient {
+public:
+  int  available() { return 0; }
+  void setTimeout(unsigned long) {}
+};
+
+class ESP8266WiFiClass {
+public:
+  bool isConnected() { return true; }
+};
+extern ESP8266WiFiClass WiFi;
+
+#endif // HOST_ESP8266WIFI_H
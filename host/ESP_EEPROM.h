@@ -0,0 +1,41 @@
+/*!
+ *  @file ESP_EEPROM.h
+ *
+ *  Host stand-in for ESP_EEPROM, the flash is a static array, it holds data after the first commit.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HOST_ESP_EEPROM_H
+#define HOST_ESP_EEPROM_H
+
+#include "Arduino.h"
+
+#define HOST_EEPROM_SIZE  4096
+
+class EEPROMClass {
+public:
+  void begin(size_t size) { this->size = size; }
+  int  percentUsed() { return committed ? 0 : -1; }
+  template<typename T> T& get(int address, T& t) {
+    memcpy(&t, data + address, sizeof(T));
+    return t;
+  }
+  template<typename T> const T& put(int address, const T& t) {
+    if (address + sizeof(T) <= size) {
+      memcpy(data + address, &t, sizeof(T));
+    }
+    return t;
+  }
+  bool commit() { committed = (size <= HOST_EEPROM_SIZE); return committed; }
+  void end() {}
+private:
+  uint8_t data[HOST_EEPROM_SIZE] = {};
+  size_t  size = 0;
+  bool    committed = false;
+};
+extern EEPROMClass EEPROM;
+
+#endif // HOST_ESP_EEPROM_H
@@ -0,0 +1,2 @@
+// the sources include HUNTER_CTRL.h, the file is hunter_ctrl.h
+#include "../hunter_ctrl.h"
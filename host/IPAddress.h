@@ -0,0 +1,27 @@
+/*!
+ *  @file IPAddress.h
+ *
+ *  Host stand-in for the IPAddress class of the ESP8266 Arduino core, without toString().
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include "Arduino.h"
+
+class IPAddress {
+public:
+  IPAddress() : bytes{} {}
+  IPAddress(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4) : bytes{ b1, b2, b3, b4 } {}
+  uint8_t operator[](int index) const { return bytes[index]; }
+  bool operator==(const IPAddress& other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+  bool operator!=(const IPAddress& other) const { return !(*this == other); }
+private:
+  uint8_t bytes[4];
+};
+
+#endif // HOST_IPADDRESS_H
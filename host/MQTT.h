@@ -0,0 +1,2 @@
+// the sources include MQTT.h, the file is mqtt.h
+#include "../mqtt.h"
@@ -0,0 +1,2 @@
+// the sources include OLED.h, the file is oled.h
+#include "../oled.h"
@@ -0,0 +1,55 @@
+/*!
+ *  @file PubSubClient.h
+ *
+ *  Host stand-in for PubSubClient, every connect succeeds and the last published message is kept
+ *  in static buffers for the checks. deliver() builds a PUBLISH packet in the receive buffer the same
+ *  way the library does and hands topic and payload to the callback.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+#define MQTT_CONNECTED  0
+
+#define HOST_MQTT_BUFFER  1024
+
+class PubSubClient {
+public:
+  PubSubClient(WiFiClient&) : callback(nullptr), isConnected(false) {}
+  PubSubClient& setServer(IPAddress, uint16_t) { return *this; }
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size) { return size <= HOST_MQTT_BUFFER; }
+  bool connect(const char*, const char*, const char*, const char*, uint8_t, bool, const char*, bool) {
+    isConnected = true;
+    return true;
+  }
+  void disconnect() { isConnected = false; }
+  bool connected() { return isConnected; }
+  int  state() { return isConnected ? MQTT_CONNECTED : -1; }
+  bool loop() { return isConnected; }
+  bool subscribe(const char*, uint8_t = 0) { return true; }
+  bool unsubscribe(const char*) { return true; }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool = false);
+  void deliver(const char* topic, const uint8_t* payload, unsigned int length, uint16_t packetId, bool dup);
+
+  // last published message, zero terminated
+  static char           lastTopic[HOST_MQTT_BUFFER];
+  static char           lastPayload[HOST_MQTT_BUFFER];
+  static unsigned long  published;
+
+private:
+  MQTT_CALLBACK_SIGNATURE;
+  bool    isConnected;
+  uint8_t buffer[HOST_MQTT_BUFFER];
+};
+
+#endif // HOST_PUBSUBCLIENT_H
@@ -0,0 +1,37 @@
+/*!
+ *  @file SSD1306Wire.h
+ *
+ *  Host stand-in for the display driver, draws nothing.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HOST_SSD1306WIRE_H
+#define HOST_SSD1306WIRE_H
+
+#include "Arduino.h"
+
+#define TEXT_ALIGN_LEFT 0
+#define BLACK           0
+#define WHITE           1
+
+extern const uint8_t ArialMT_Plain_10[];
+extern const uint8_t ArialMT_Plain_16[];
+
+class SSD1306Wire {
+public:
+  SSD1306Wire(uint8_t, uint8_t, uint8_t) {}
+  bool init() { return true; }
+  void clear() {}
+  void display() {}
+  void flipScreenVertically() {}
+  void setFont(const uint8_t*) {}
+  void setTextAlignment(int) {}
+  void setColor(int) {}
+  void fillRect(int16_t, int16_t, int16_t, int16_t) {}
+  void drawString(int16_t, int16_t, const char*) {}
+};
+
+#endif // HOST_SSD1306WIRE_H
@@ -0,0 +1 @@
+// host stand-in, the display driver needs no I2C setup on the host
@@ -0,0 +1,163 @@
+/*!
+ *  @file host_stubs.cpp
+ *
+ *  Definitions of the host stand-ins for the ESP8266 core and the libraries, see Arduino.h.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include <chrono>
+#include <thread>
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include "PubSubClient.h"
+#include "ESP_EEPROM.h"
+#include "SSD1306Wire.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+EEPROMClass EEPROM;
+
+const uint8_t ArialMT_Plain_10[] = { 0 };
+const uint8_t ArialMT_Plain_16[] = { 0 };
+
+char          PubSubClient::lastTopic[HOST_MQTT_BUFFER];
+char          PubSubClient::lastPayload[HOST_MQTT_BUFFER];
+unsigned long PubSubClient::published = 0;
+
+HOST_EDGE hostEdges[HOST_MAX_EDGES];
+size_t    hostEdgeCount = 0;
+
+// RTC user memory of the ESP8266, 128 words
+static uint32_t rtcMemory[128];
+
+// timer1, its clock only advances when the armed interval expires
+static timercallback timer1Callback = nullptr;
+static uint8_t       timer1Divider = TIM_DIV1;
+static bool          timer1Enabled = false;
+static uint32_t      timer1Armed = 0;       // ticks of the running interval, 0 if none
+static uint64_t      timer1Cycles = 0;      // 80 MHz cycles since start
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+long secureRandom(long howbig) {
+  return howbig ? (rand() % howbig) : 0;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (hostEdgeCount < HOST_MAX_EDGES) {
+    hostEdges[hostEdgeCount] = { pin, val, (uint32_t)(timer1Cycles / 80) };
+  }
+  hostEdgeCount++;
+}
+
+void timer1_attachInterrupt(timercallback userFunc) {
+  timer1Callback = userFunc;
+}
+
+void timer1_enable(uint8_t divider, uint8_t, uint8_t) {
+  timer1Divider = divider;
+  timer1Enabled = true;
+}
+
+void timer1_write(uint32_t ticks) {
+  timer1Armed = ticks;
+}
+
+void timer1_disable() {
+  timer1Enabled = false;
+  timer1Armed = 0;
+}
+
+/*!
+ * @brief lets the armed interval of timer1 expire, the clock advances by it and the ISR is called
+ *
+ * @return false if timer1 is disabled or not armed
+ */
+bool hostTimer1Expire() {
+  if (!timer1Enabled || !timer1Armed || !timer1Callback) {
+    return false;
+  }
+  timer1Cycles += (uint64_t)timer1Armed << ((timer1Divider == TIM_DIV256) ? 8 : 4 * timer1Divider);
+  timer1Armed = 0;    // single shot, the ISR arms the next interval
+  timer1Callback();
+  return true;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+  if ((offset * 4 + size) > sizeof(rtcMemory)) {
+    return false;
+  }
+  memcpy(data, rtcMemory + offset, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+  if ((offset * 4 + size) > sizeof(rtcMemory)) {
+    return false;
+  }
+  memcpy(rtcMemory + offset, data, size);
+  return true;
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool) {
+  if (!isConnected || (length >= sizeof(lastPayload))) {
+    return false;
+  }
+  strlcpy(lastTopic, topic, sizeof(lastTopic));
+  memcpy(lastPayload, payload, length);
+  lastPayload[length] = 0;
+  published++;
+  return true;
+}
+
+/*!
+ * @brief hands a received QoS 1 message to the callback, the receive buffer is laid out as by the library
+ *
+ *   fixed header | remaining length | topic length | topic | packet ID | payload
+ * the library moves the topic a byte to the front to zero terminate it, the callback sees the same pointers
+ *
+ * @param topic     topic of the message
+ * @param payload   the message
+ * @param length    length of the message
+ * @param packetId  packet ID, not 0
+ * @param dup       DUP flag of the fixed header
+ */
+void PubSubClient::deliver(const char* topic, const uint8_t* payload, unsigned int length, uint16_t packetId, bool dup) {
+  size_t topicLength = strlen(topic);
+  uint32_t remaining = 2 + topicLength + 2 + length;
+  if (!callback || (remaining + 5 > sizeof(buffer))) {
+    return;
+  }
+  size_t pos = 0;
+  buffer[pos++] = 0x32 | (dup ? 0x08 : 0x00);   // PUBLISH, QoS 1
+  do {
+    byte digit = remaining % 128;
+    remaining /= 128;
+    buffer[pos++] = digit | (remaining ? 0x80 : 0x00);
+  } while (remaining);
+  buffer[pos++] = topicLength >> 8;
+  memcpy(buffer + pos, topic, topicLength);     // in place of the low byte of the topic length
+  buffer[pos + topicLength] = 0;
+  char* receivedTopic = (char*)buffer + pos;
+  pos += topicLength + 1;
+  buffer[pos++] = packetId >> 8;
+  buffer[pos++] = packetId & 0xff;
+  memcpy(buffer + pos, payload, length);
+  callback(receivedTopic, buffer + pos, length);
+}
@@ -0,0 +1,401 @@
+/*!
+ *  @file host_test.cpp
+ *
+ *  Host checks of the command parser and the publish path, see README.
+ *
+ *  Runs frame encoding, the binary and JSON command handlers, the QoS 1 dedupe and the value message
+ *  against the stand-ins of this folder, checks their results and times them. Every allocation is
+ *  counted, the paths of a received command and of a published message have to run without heap.
+ *  The REM transmitter is driven by the simulated timer1, its edges are checked against the pulse
+ *  lengths of hunter_wave.h.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include <chrono>
+#include <new>
+#include "Arduino.h"
+#include "PubSubClient.h"
+#include "../app_data.h"
+#include "../mqtt.h"
+#include "../telemetry.h"
+#include "../json_writer.h"
+#include "../hunter_frame.h"
+#include "../hunter_ctrl.h"
+#include "../oled.h"
+
+#define BENCH_RUNS  10000
+
+// ================================ heap accounting ==================================
+
+// the linker routes malloc and friends of the sources through these, see Makefile
+static unsigned long allocations = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void  __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) { allocations++; return __real_malloc(size); }
+void* __wrap_calloc(size_t count, size_t size) { allocations++; return __real_calloc(count, size); }
+void* __wrap_realloc(void* ptr, size_t size) { allocations++; return __real_realloc(ptr, size); }
+void  __wrap_free(void* ptr) { __real_free(ptr); }
+}
+
+void* operator new(size_t size) {
+  void* ptr = malloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+// ================================ checks ==================================
+
+static unsigned int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+/*!
+ * @brief runs a function BENCH_RUNS times, prints the time per run and checks that it does not allocate
+ *
+ * @param name  name of the benchmark
+ * @param run   function called with the index of the run, returns false if the run went wrong
+ */
+template <typename F>
+static void benchmark(const char* name, F run) {
+  unsigned long failed = run(0) ? 0 : 1;   // first run outside of the measurement, static state is set up
+  unsigned long before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 1; i <= BENCH_RUNS; i++) {
+    failed += run(i) ? 0 : 1;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  unsigned long allocated = allocations - before;
+  printf("%-24s %8.1f ns/run  %lu allocations\n", name, (double)elapsed / BENCH_RUNS, allocated);
+  if (allocated) {
+    printf("%s: allocates on the heap\n", name);
+    failures++;
+  }
+  if (failed) {
+    printf("%s: %lu of %u runs failed\n", name, failed, BENCH_RUNS + 1);
+    failures++;
+  }
+}
+
+// ================================ system under test ==================================
+
+extern PubSubClient mqttClient;
+
+static APP_DATA   appData;
+static MQTT       mqtt;
+static TELEMETRY  telemetry;
+static OLED       oled;
+static XCORE_CTRL hunter;
+
+#define DEVICE_TOPIC(name)  PRE_MQTT "/123456/" name   // the host chip ID is 0x123456
+
+static uint16_t cmdSeq = 0;   // sequence number of the binary records sent
+
+static unsigned int drainQueue() {
+  HUNTER_CMD cmd;
+  unsigned int count = 0;
+  while (appData.popHunterCmd(0, cmd)) {
+    count++;
+  }
+  return count;
+}
+
+static MQTT_CMD_RECORD record(const MQTT_CMD_OPCODE opcode, const byte zone, const byte minutes) {
+  cmdSeq++;
+  return { opcode, zone, minutes, (byte)(cmdSeq >> 8), (byte)(cmdSeq & 0xff) };
+}
+
+static boolean config(const char* message) {
+  return handleConfigMessage((const byte*)message, strlen(message), CMD_SOURCE::SRC_DEVICE);
+}
+
+static void testFrames() {
+  constexpr HUNTER_FRAME expected = hunterZoneFrame(3, 10);
+  volatile byte zone = 3;
+  volatile byte time = 10;
+  HUNTER_FRAME frame = hunterZoneFrame(zone, time);
+  CHECK(frame.len == ZONE_FRAME_LEN);
+  CHECK(memcmp(frame.data.data(), expected.data.data(), frame.data.size()) == 0);
+  CHECK(hunterWaveMatches(frame));
+  CHECK(hunterZoneFrame(zone + HUNTER_MAX_ZONE, time).len == 0);
+  CHECK(hunterProgramFrame(2).len == PROGRAM_FRAME_LEN);
+
+  volatile byte sink = 0;
+  benchmark("zone frame", [&](unsigned long i) {
+    HUNTER_FRAME frame = hunterZoneFrame(1 + i % HUNTER_MAX_ZONE, i % HUNTER_MAX_TIME);
+    sink = sink + frame.data[5];
+    return frame.len == ZONE_FRAME_LEN;
+  });
+}
+
+static void testCmdMessage() {
+  MQTT_CMD_RECORD records[] = { record(MQTT_CMD_OPCODE::CMD_ZONE, 4, 20), record(MQTT_CMD_OPCODE::CMD_PROGRAM, 2, 0) };
+  CHECK(handleCmdMessage((const byte*)records, sizeof(records), CMD_SOURCE::SRC_DEVICE));
+  HUNTER_CMD cmd;
+  CHECK(appData.popHunterCmd(0, cmd) && (cmd.type == HUNTER_CMD_TYPE::ZONE) && (cmd.zone == 4) && (cmd.time == 20));
+  CHECK(appData.popHunterCmd(0, cmd) && (cmd.type == HUNTER_CMD_TYPE::PROGRAM) && (cmd.program == 2));
+  CHECK(!appData.popHunterCmd(0, cmd));
+
+  // a repeated message is older than the last sequence number
+  CHECK(!handleCmdMessage((const byte*)records, sizeof(records), CMD_SOURCE::SRC_DEVICE));
+  CHECK(drainQueue() == 0);
+  MQTT_CMD_RECORD invalid = record(MQTT_CMD_OPCODE::CMD_ZONE, HUNTER_MAX_ZONE + 1, 5);
+  CHECK(!handleCmdMessage((const byte*)&invalid, sizeof(invalid), CMD_SOURCE::SRC_DEVICE));
+  CHECK(!handleCmdMessage((const byte*)&invalid, sizeof(invalid) - 1, CMD_SOURCE::SRC_DEVICE));
+  CHECK(drainQueue() == 0);
+
+  benchmark("binary command", [&](unsigned long i) {
+    MQTT_CMD_RECORD zone = record(MQTT_CMD_OPCODE::CMD_ZONE, 1 + i % HUNTER_MAX_ZONE, 10);
+    return handleCmdMessage((const byte*)&zone, sizeof(zone), CMD_SOURCE::SRC_DEVICE) && (drainQueue() == 1);
+  });
+}
+
+static void testConfigMessage() {
+  CHECK(config("{\"water\":{\"zone\":3,\"time\":10}}"));
+  HUNTER_CMD cmd;
+  CHECK(appData.popHunterCmd(0, cmd) && (cmd.type == HUNTER_CMD_TYPE::ZONE) && (cmd.zone == 3) && (cmd.time == 10));
+  CHECK(!config("{\"water\":{\"zone\":99,\"time\":10}}"));
+  CHECK(!config("{\"water\":{\"zone\":3}}"));
+  CHECK(!config("{\"water\":{\"zone\":3,"));
+  CHECK(drainQueue() == 0);
+
+  CHECK(config("{\"water\":{\"program\":2,\"seq\":7}}"));
+  CHECK(!config("{\"water\":{\"program\":2,\"seq\":7}}"));
+  CHECK(drainQueue() == 1);
+
+  uint16_t version = appData.getHunterPlanVersion(0);
+  CHECK(config("{\"water\":{\"plan\":[{\"zone\":1,\"minutes\":5,\"gap\":30},{\"zone\":2,\"minutes\":7}]}}"));
+  const HUNTER_PLAN& plan = appData.getHunterPlan(0);
+  CHECK(appData.getHunterPlanVersion(0) != version);
+  CHECK((plan.count == 2) && (plan.steps[0].zone == 1) && (plan.steps[0].gap == 30) && (plan.steps[1].minutes == 7));
+  HUNTER_FRAME expected = hunterZoneFrame(1, 5);
+  CHECK(memcmp(plan.steps[0].frame.data.data(), expected.data.data(), expected.data.size()) == 0);
+
+  char message[64];
+  benchmark("config message", [&](unsigned long i) {
+    snprintf(message, sizeof(message), "{\"water\":{\"zone\":%lu,\"time\":10}}", 1 + i % HUNTER_MAX_ZONE);
+    return config(message) && (drainQueue() == 1);
+  });
+  printf("config arena peak %u of %u bytes\n", (unsigned)MQTT::getArenaPeak(), (unsigned)MQTT::getArenaCapacity());
+  CHECK(MQTT::getArenaPeak() <= MQTT::getArenaCapacity());
+}
+
+static void testRedelivery() {
+  const char* topic = DEVICE_TOPIC("config");
+  const char* message = "{\"water\":{\"zone\":5,\"time\":1}}";
+  CHECK(mqtt.route(topic) != nullptr);
+  mqttClient.deliver(topic, (const uint8_t*)message, strlen(message), 10, false);
+  CHECK(drainQueue() == 1);
+  // the broker sends it again with the DUP flag, its PUBACK got lost
+  mqttClient.deliver(topic, (const uint8_t*)message, strlen(message), 10, true);
+  CHECK(drainQueue() == 0);
+  // without the flag the packet ID is reused by a new message
+  mqttClient.deliver(topic, (const uint8_t*)message, strlen(message), 10, false);
+  CHECK(drainQueue() == 1);
+}
+
+static void testPublish() {
+  CHECK(strcmp(PubSubClient::lastTopic, DEVICE_TOPIC("value")) == 0);
+  CHECK(strcmp(PubSubClient::lastPayload,
+               "{\"wifi\":{\"ssid\":\"ssid\",\"ip\":\"0.0.0.0\"},\"broker\":{\"ip\":\"10.0.0.2\",\"port\":1883}}") == 0);
+
+  HUNTER_CMD cmd = {};
+  cmd.type = HUNTER_CMD_TYPE::ZONE;
+  cmd.zone = 3;
+  cmd.time = 10;
+  telemetry.setHunter(cmd, 1, 0);
+  telemetry.loop();
+  CHECK(strcmp(PubSubClient::lastPayload, "{\"hunter\":{\"zone\":3,\"time\":10,\"queued\":1,\"skipped\":0}}") == 0);
+
+  unsigned long published = PubSubClient::published;
+  benchmark("value message", [&](unsigned long i) {
+    cmd.zone = 1 + i % HUNTER_MAX_ZONE;
+    telemetry.setHunter(cmd, 0, 0);
+    telemetry.loop();
+    return true;
+  });
+  CHECK(PubSubClient::published == published + BENCH_RUNS + 1);
+}
+
+static void testJsonWriter() {
+  char buffer[64];
+  JSON_WRITER json(buffer, sizeof(buffer));
+  json.beginObject()
+        .add("ok", true)
+        .add("counter", (uint32_t)4000000000UL)
+        .add("temp", 21.5f, 1)
+        .beginArray("heap")
+          .value(-1)
+        .endArray()
+      .endObject();
+  CHECK(!json.overflowed());
+  CHECK(strcmp(json.c_str(), "{\"ok\":true,\"counter\":4000000000,\"temp\":21.5,\"heap\":[-1]}") == 0);
+
+  char small[8];
+  JSON_WRITER tooSmall(small, sizeof(small));
+  tooSmall.beginObject().add("counter", 12345678).endObject();
+  CHECK(tooSmall.overflowed());
+}
+
+static void testConnectionFallback() {
+  // a parameter change is stored while new broker parameters are still being tried
+  appData.setDhtTempOffset(2);
+  appData.setMqttPort(1999);
+  appData.storeEEProm();
+  CHECK(appData.flushEEProm());
+  CHECK(!appData.restoreConnection());
+  CHECK(appData.getMqttPort() == 1883);
+  CHECK(appData.getDhtTempOffset() == 2);
+  // the flash holds the working port and the new offset
+  appData.initialize("ssid", "pw", "10.0.0.2", 1883);
+  CHECK(appData.getMqttPort() == 1883);
+  CHECK(appData.getDhtTempOffset() == 2);
+}
+
+static void testUdpCounter() {
+  uint16_t commits = appData.getEEpromCommits();
+  CHECK(appData.setUdpCounter(5));
+  CHECK(appData.getEEpromCommits() == commits + 1);
+  // the reserve takes the next counters without a flash commit
+  for (uint32_t counter = 6; counter < 5 + UDP_COUNTER_RESERVE; counter++) {
+    CHECK(appData.setUdpCounter(counter));
+  }
+  CHECK(appData.getEEpromCommits() == commits + 1);
+  CHECK(!appData.setUdpCounter(100));
+  CHECK(appData.setUdpCounter(5 + UDP_COUNTER_RESERVE));
+  CHECK(appData.getEEpromCommits() == commits + 2);
+  // a power cycle starts at the reserve, no counter taken before is accepted again
+  uint32_t last = appData.getUdpCounter();
+  appData.initialize("ssid", "pw", "10.0.0.2", 1883);
+  CHECK(appData.getUdpCounter() == 5 + 2 * UDP_COUNTER_RESERVE);
+  // a reset continues with the exact counter of RTC memory
+  CHECK(appData.restoreRuntimeState());
+  CHECK(appData.getUdpCounter() == last);
+  CHECK(!appData.setUdpCounter(last));
+}
+
+/*!
+ * @brief gets the expected length of a pulse, decoded from the frame bits independent of hunter_wave.h
+ *
+ * @param frame  the frame sent
+ * @param edge   index of the edge starting the pulse
+ * @return the pulse length in us
+ */
+static uint32_t expectedPulse(const HUNTER_FRAME& frame, const size_t edge) {
+  switch (edge) {
+    case 0: return RESET_INTERVAL * 1000UL;
+    case 1: return RESET_PAUSE * 1000UL;
+    case 2: return START_INTERVAL;
+    case 3: return SHORT_INTERVAL;
+  }
+  size_t pos = (edge - 4) / 2;
+  size_t bits = frame.len * 8;
+  bool bit = (pos < bits) ? (frame.data[pos / 8] & (0x80 >> (pos % 8))) : (frame.extrabit && (pos == bits));
+  bool high = ((edge - 4) % 2) == 0;
+  return (high == bit) ? LONG_INTERVAL : SHORT_INTERVAL;
+}
+
+static void testTransmitter() {
+  // an invalid command drives no edge
+  hostEdgeCount = 0;
+  CHECK(!hunter.startZone(HUNTER_MAX_ZONE + 1, 10));
+  CHECK(hostEdgeCount == 0);
+
+  CHECK(hunter.startZone(3, 10));
+  CHECK(hunter.isBusy());
+  CHECK(!hunter.startZone(4, 10));
+  while (hostTimer1Expire()) {
+  }
+  CHECK(!hunter.isBusy());
+
+  // every pulse starts with an edge, the last one releases the line
+  HUNTER_FRAME frame = hunterZoneFrame(3, 10);
+  size_t pulses = hunterEdgeCount(frame.len * 8, frame.extrabit);
+  CHECK(hostEdgeCount == pulses + 1);
+  if (hostEdgeCount != pulses + 1) {
+    return;
+  }
+  size_t wrongPulses = 0;
+  for (size_t i = 0; i < pulses; i++) {
+    if ((hostEdges[i].pin != HUNTER_PIN) || (hostEdges[i].level != ((i % 2) ? LOW : HIGH))
+        || (hostEdges[i + 1].at - hostEdges[i].at != expectedPulse(frame, i))) {
+      printf("pulse %zu: level %u for %lu us\n", i, hostEdges[i].level,
+             (unsigned long)(hostEdges[i + 1].at - hostEdges[i].at));
+      wrongPulses++;
+    }
+  }
+  CHECK(wrongPulses == 0);
+  CHECK(hostEdges[pulses].level == LOW);
+}
+
+static boolean mirrorDown(const char*) {
+  return false;
+}
+
+static void testLogger() {
+  // the broker is down, the mirror takes nothing
+  appLog.setMirror(mirrorDown);
+  for (byte i = 0; i <= LOG_MIRROR_LINES; i++) {
+    LOG_WARN("broker down %u", i);
+  }
+  uint32_t dropped = appLog.getDropped();
+  uint32_t mirrorDropped = appLog.getMirrorDropped();
+  CHECK(mirrorDropped == 1);
+  // the overflow report goes to Serial only and does not count as a new loss
+  for (byte i = 0; i < 10; i++) {
+    appLog.loop();
+  }
+  CHECK(appLog.getDropped() == dropped);
+  CHECK(appLog.getMirrorDropped() == mirrorDropped);
+  CHECK(!appLog.pending());
+  appLog.setMirror(nullptr);
+}
+
+int main() {
+  appData.initialize("ssid", "pw", "10.0.0.2", 1883);
+  mqtt.initialize(nullptr, &appData);
+  mqtt.initMqttServer();
+  mqtt.loop();
+  CHECK(mqtt.getState() == MQTT_STATE::BROKER_CONNECTED);
+  telemetry.initialize(&mqtt, &appData);
+  telemetry.loop();
+  oled.initialize();
+  hunter.initialize(&oled, &appData, 0, HUNTER_PIN, NO_PUMP);
+
+  testFrames();
+  testCmdMessage();
+  testConfigMessage();
+  testRedelivery();
+  testPublish();
+  testJsonWriter();
+  testConnectionFallback();
+  testUdpCounter();
+  testLogger();
+  testTransmitter();
+
+  if (failures) {
+    printf("%u checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -54,6 +54,37 @@
 #include "mqtt.h"			// MQTT client abstraction class
 #include "app_data.h"		// class for all application data
 #include "hunter_ctrl.h" // HunterCore abstraction class
+#include "water_schedule.h"	// weekly watering schedule
+#include "dispatcher.h"		// dispatcher for DATA_UPDATE flags
+#include "scheduler.h"		// cooperative scheduler for all subsystems
+#include "telemetry.h"		// coalescing publisher of the value topic
+#include "history.h"		// history of the DHT values
+#include "stats.h"		// run time statistics, see USE_STATS
+#include "logger.h"		// ring buffered serial log, see LOG_LEVEL
+#include "udp_cmd.h"		// authenticated commands from the LAN, see USE_UDP
+
+// periods of the scheduler tasks in ms
+#define WIFI_PERIOD      1000
+#define MQTT_PERIOD      100   // woken early by received data
+#define DISPATCH_PERIOD  500   // triggered early by MQTT updates
+#define HUNTER_PERIOD    100   // woken early by completed frames and queued commands
+#define OLED_PERIOD      250
+#define DHT_PERIOD       (MIN_INTERVAL + 50)   // slack for the scheduler jitter, sample() refuses reads closer than MIN_INTERVAL
+#define DHT_RETRY        100   // a read postponed by a Hunter frame is tried again after this time
+#define TELEMETRY_PERIOD 250   // woken early by priority fields
+#define EEPROM_PERIOD    1000  // pending store requests are written after EEPROM_STORE_DELAY
+#define HISTORY_PERIOD   1000
+#define STATS_PERIOD     1000
+#define LOG_PERIOD       100   // woken early by pending serial output
+#define UDP_PERIOD       100   // woken early by received datagrams
+
+#define MQTT_NEW_PARAMS_TRIES  5   // failed attempts before new broker parameters are thrown away
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define BOOT_SERIAL_DELAY  8000  // ms to open the serial monitor, debug builds only
+#else
+#define BOOT_SERIAL_DELAY  0     // a reset is back on the bus and the network right away
+#endif
 
 // ==================================================
 // instanciates needed classes
@@ -62,90 +93,262 @@ OLED oledDisplay;
 WIFI_CTRL wifiCtrl;
 MQTT mqttCtrl;
 APP_DATA appData;
-HUNTER_CTRL hunterCtrl;
+XCORE_CTRL hunterCtrl[HUNTER_CONTROLLERS];
+WATER_SCHEDULE waterSchedule;
+DISPATCHER dispatcher;
+SCHEDULER scheduler;
+TELEMETRY telemetry;
+HISTORY history;
+#if USE_UDP
+UDP_CMD udpCmd;
+#endif
+int8_t dispatchTaskId = NO_TASK;
+int8_t dhtTaskId = NO_TASK;
 
-void setup() {
-  // Serial port for debugging purposes
-  Serial.begin(74880);  
-  delay(8000);  // to give time for serial port
-  Serial.println(" ");
-  
-  // components init
-  Serial.println("Starting init of all components ...");
-  // initialize dependencies
-  appData.initialize(WIFI_SSID, WIFI_PASSWORD, MQTT_SERVER_IP, MQTT_SERVER_PORT);  // params are defaults in case eeprom is empty
-  dhtSensor.initialize(&oledDisplay, &appData);
-  wifiCtrl.initialize(&oledDisplay, &appData);
-  mqttCtrl.initialize(&oledDisplay, &appData);
-  hunterCtrl.initialize(&oledDisplay, &appData);
-  oledDisplay.initialize();
+// ==================================================
+// handlers for DATA_UPDATE flags, return true if the flag shall be cleared
 
-  // start wifi (ssid and pw from appData)
-  if (false == wifiCtrl.connect()) {
-    while(1) {}
+/*!
+ *  @brief  Sends queued watering commands, HUNTER_CTRL clears the flags when the queue is empty.
+ */
+boolean onHunterUpdate(DATA_UPDATE flag) {
+  LOG_DEBUG("NewData flag for HUNTER, queued commands: %u", (unsigned)appData.getHunterCmdCount());
+  for (XCORE_CTRL& ctrl : hunterCtrl) {
+    ctrl.loop();
   }
+  return false;
+}
 
-  // start mqtt connection (brokerIP and brokerPort from appData)
-  if (false == mqttCtrl.initMqttServer()) {
-    while(1) {}
+/*!
+ *  @brief  Connects with new WIFI parameter and triggers a new MQTT connection.
+ */
+boolean onWifiUpdate(DATA_UPDATE flag) {
+  LOG_DEBUG("NewData flag for WIFI");
+  wifiCtrl.connect();
+  // wifi connects in the background, MQTT waits for it before the first attempt
+  // set flag to reastablish MQTT as well before storing epprom in successful MQTT connection
+  appData.setNewDataFlag(DATA_UPDATE::MQTT_UPDATED);
+  return true;
+}
+
+/*!
+ *  @brief  Connects with new MQTT parameter, they are stored by MQTT if successful.
+ *
+ *  The connection is established in the background, the flag is kept until it is
+ *  connected or MQTT_NEW_PARAMS_TRIES attempts failed.
+ */
+boolean onMqttUpdate(DATA_UPDATE flag) {
+  static boolean connecting = false;
+  if (!connecting) {
+    LOG_DEBUG("NewData flag for MQTT");
+    connecting = mqttCtrl.initMqttServer();
+    return !connecting;
   }
+  if (mqttCtrl.getState() == MQTT_STATE::BROKER_CONNECTED) {
+    connecting = false;
+    return true;
+  }
+  if (mqttCtrl.getFailedAttempts() >= MQTT_NEW_PARAMS_TRIES) {
+    LOG_WARN("new MQTT parameter failed, using previous ones");
+    connecting = false;
+    // new MQTT parameter did not work, back to the last working connection, other changes are kept
+    if (appData.restoreConnection()) {
+      wifiCtrl.connect();
+    }
+    mqttCtrl.initMqttServer();
+    return true;
+  }
+  return false;
 }
 
-void loop() {
-  // in case MQTT has updated WIFI or MQTT connection parameter, trigger new connections
-  DATA_UPDATE  newData = appData.getNewDataFlag();
-  if (newData == DATA_UPDATE::WIFI_UPDATED) {
-    Serial.println("NewData flag for WIFI");
-    appData.clearNewDataFlag(DATA_UPDATE::WIFI_UPDATED);
-    wifiCtrl.connect();
-    // wifi is connected, if we are here
-    // set flag to reastablish MQTT as well before storing epprom in successful MQTT connection
-    appData.setNewDataFlag(DATA_UPDATE::MQTT_UPDATED);  
-  }
-  if (newData == DATA_UPDATE::MQTT_UPDATED) {
-    Serial.println("NewData flag for MQTT");
-    if (mqttCtrl.initMqttServer()) {
-      appData.clearNewDataFlag(DATA_UPDATE::MQTT_UPDATED);
-      appData.storeEEProm();
-    } else {
-      // new MQTT parameter did not work, reset to connection params to EEProm data 
-      appData.initialize(WIFI_SSID, WIFI_PASSWORD, MQTT_SERVER_IP, MQTT_SERVER_PORT);  // params are defaults in case eeprom is empty
+/*!
+ *  @brief  Publishes changed DHT parameter.
+ */
+boolean onDhtUpdate(DATA_UPDATE flag) {
+  LOG_DEBUG("NewData flag for DHT");
+  telemetry.setDhtParams(appData.getDhtTempLevel(), appData.getDhtHumLevel(), appData.getDhtTempOffset());
+  return true;
+}
+
+// ==================================================
+// scheduler tasks
+
+void wifiTask() { wifiCtrl.loop(); }
+
+void mqttTask() {
+  mqttCtrl.loop();
+  // a received subscription may have set new data flags, handle them right away
+  if (appData.getNewDataFlag() != DATA_UPDATE::DATA_UNSET) {
+    scheduler.trigger(dispatchTaskId);
+  }
+}
+boolean mqttWake() { return mqttCtrl.dataAvailable(); }
+
+void dispatchTask() { dispatcher.dispatch(); }
+
+void hunterTask() {
+  static uint16_t reportedCount[HUNTER_CONTROLLERS] = {};
+  static uint16_t reportedSkipped[HUNTER_CONTROLLERS] = {};
+  static byte first = 0;
+  waterSchedule.loop();
+  // all buses share timer1, the controller served first rotates so that no bus starves
+  for (byte n = 0; n < HUNTER_CONTROLLERS; n++) {
+    byte i = (first + n) % HUNTER_CONTROLLERS;
+    hunterCtrl[i].loop();
+    // report every command gone out on the bus, a redundant one is acknowledged as well
+    uint16_t sent = hunterCtrl[i].getSentCount();
+    uint16_t skipped = hunterCtrl[i].getSkippedCount();
+    if (sent != reportedCount[i]) {
+      first = (i + 1) % HUNTER_CONTROLLERS;
+    }
+    if ((sent != reportedCount[i]) || (skipped != reportedSkipped[i])) {
+      reportedCount[i] = sent;
+      reportedSkipped[i] = skipped;
+      telemetry.setHunter(hunterCtrl[i].getLastCmd(), appData.getHunterCmdCount(i), skipped);
+    }
+  }
+}
+boolean hunterWake() {
+  for (const XCORE_CTRL& ctrl : hunterCtrl) {
+    if (ctrl.hasWork()) {
+      return true;
     }
   }
-  if (newData == DATA_UPDATE::DHT_UPDATED) {
-    Serial.println("NewData flag for DHT");
-    appData.clearNewDataFlag(DATA_UPDATE::DHT_UPDATED);
-    mqttCtrl.publishDHTParams(appData.getDhtTempLevel(), appData.getDhtHumLevel(), appData.getDhtTempOffset());
-  }       
-  if (newData == DATA_UPDATE::HUNTER_ZONE_UPDATED) {
-    Serial.println("NewData flag for HUNTER ZONE");
-    appData.clearNewDataFlag(DATA_UPDATE::HUNTER_ZONE_UPDATED);
-    hunterCtrl.startZone(appData.getHunterZone(), appData.getHunterTime());
-  }
-  if (newData == DATA_UPDATE::HUNTER_PROGRAM_UPDATED) {
-    Serial.println("NewData flag for HUNTER PROGRAM");
-    appData.clearNewDataFlag(DATA_UPDATE::HUNTER_PROGRAM_UPDATED);
-    hunterCtrl.startProgram(appData.getHunterProgram());
+  return false;
+}
+// a frame is going out on one of the buses
+boolean hunterBusy() {
+  for (const XCORE_CTRL& ctrl : hunterCtrl) {
+    if (ctrl.isBusy()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void oledTask() { oledDisplay.updateScreen(); }
+
+void dhtTask() {
+  // a sensor read disables interrupts, it would stretch the pulses of a frame on the Hunter bus
+  if (hunterBusy()) {
+    scheduler.trigger(dhtTaskId, DHT_RETRY);
+    return;
+  }
+  if (dhtSensor.sample()) {
+    history.addSample(dhtSensor.getFilteredTemperature(), dhtSensor.getFilteredHumidity());
   }
-  
   // check for new data from DHT sensor
   if (dhtSensor.newDataAvailable()) {
     // new temperatur or humidity
     float h = dhtSensor.getHumidity();
     // Read temperature as Celsius
     float t = dhtSensor.getTemperature();
-    // Publishes Temperature and Humidity values via MQTT
-    if (false == mqttCtrl.publishDHT(t, h) ) {
-      Serial.println("DHT publishing failed");
-    } else {
-      Serial.println("DHT publishing Done");
-    };
+    // Temperature and Humidity values are published with the next value message
+    telemetry.setDht(t, h);
   }
+}
 
-  wifiCtrl.loop();
-  mqttCtrl.loop();
-  
-  oledDisplay.updateScreen();
+void telemetryTask() { telemetry.loop(); }
+boolean telemetryWake() { return telemetry.flushDue(); }
+
+// a flash commit stalls the cache, the I2S refill callback is not completely in IRAM
+void eepromTask() { if (!hunterBusy()) { appData.loop(); } }
+
+void historyTask() { history.loop(); }
+
+#if USE_STATS
+void statsTask() { appStats.loop(); }
+#endif
 
-  delay(500);  // to give time for serial port
+#if USE_UDP
+void udpTask() {
+  udpCmd.loop();
+  // an accepted datagram may have set new data flags, handle them right away
+  if (appData.getNewDataFlag() != DATA_UPDATE::DATA_UNSET) {
+    scheduler.trigger(dispatchTaskId);
+  }
+}
+boolean udpWake() { return udpCmd.dataAvailable(); }
+#endif
+
+void logTask() { appLog.loop(); }
+// only while the UART takes data, a full FIFO would wake the scheduler every millisecond
+boolean logWake() { return appLog.pending() && (Serial.availableForWrite() > 0); }
+boolean logMirror(const char* line) { return mqttCtrl.publishLog(line); }
+
+void setup() {
+  // Serial port for debugging purposes
+  // the I2S output of the Hunter bus takes the RX pin
+  Serial.begin(74880, SERIAL_8N1, (HUNTER_PIN == HUNTER_I2S_PIN) ? SERIAL_TX_ONLY : SERIAL_FULL);  
+  if (BOOT_SERIAL_DELAY) {
+    delay(BOOT_SERIAL_DELAY);  // to give time for serial port
+  }
+
+  // components init
+  LOG_INFO("Starting init of all components ...");
+  // initialize dependencies
+  appData.initialize(WIFI_SSID, WIFI_PASSWORD, MQTT_SERVER_IP, MQTT_SERVER_PORT);  // params are defaults in case eeprom is empty
+  oledDisplay.initialize();
+
+  // networking first, WIFI (ssid and pw from appData) associates in the background while the rest comes up
+  wifiCtrl.initialize(&oledDisplay, &appData);
+  mqttCtrl.initialize(&oledDisplay, &appData);
+  if (false == wifiCtrl.connect()) {
+    appLog.flush();
+    while(1) {}
+  }
+  // mqtt connects with the first loop after WIFI is up (brokerIP and brokerPort from appData)
+  if (false == mqttCtrl.initMqttServer()) {
+    appLog.flush();
+    while(1) {}
+  }
+
+  dhtSensor.initialize(&oledDisplay, &appData);
+  // queued commands of a previous run survive a reset in RTC memory
+  if (appData.restoreRuntimeState()) {
+    LOG_INFO("fast boot, restored queued commands: %u", (unsigned)appData.getHunterCmdCount());
+  }
+  static const uint8_t remPins[] = HUNTER_PINS;
+  static const uint8_t pumpPins[] = PUMP_PINS;
+  for (byte i = 0; i < HUNTER_CONTROLLERS; i++) {
+    hunterCtrl[i].initialize(&oledDisplay, &appData, i, remPins[i], pumpPins[i]);
+  }
+  waterSchedule.initialize(&appData);
+  telemetry.initialize(&mqttCtrl, &appData);
+  history.initialize(&mqttCtrl);
+#if USE_UDP
+  udpCmd.initialize(&appData);
+#endif
+  STATS_ONLY(appStats.initialize(&mqttCtrl);)
+  appLog.setMirror(logMirror);
+
+  // handlers in priority order, watering first
+  dispatcher.initialize(&appData);
+  dispatcher.registerHandler(DATA_UPDATE::HUNTER_ZONE_UPDATED, onHunterUpdate);
+  dispatcher.registerHandler(DATA_UPDATE::HUNTER_PROGRAM_UPDATED, onHunterUpdate);
+  dispatcher.registerHandler(DATA_UPDATE::HUNTER_PLAN_UPDATED, onHunterUpdate);
+  dispatcher.registerHandler(DATA_UPDATE::WIFI_UPDATED, onWifiUpdate);
+  dispatcher.registerHandler(DATA_UPDATE::MQTT_UPDATED, onMqttUpdate);
+  dispatcher.registerHandler(DATA_UPDATE::DHT_UPDATED, onDhtUpdate);
+
+  // tasks are run in this order when due at the same time, watering first
+  scheduler.addTask(hunterTask, HUNTER_PERIOD, hunterWake);
+  scheduler.addTask(mqttTask, MQTT_PERIOD, mqttWake);
+#if USE_UDP
+  scheduler.addTask(udpTask, UDP_PERIOD, udpWake);
+#endif
+  dispatchTaskId = scheduler.addTask(dispatchTask, DISPATCH_PERIOD);
+  scheduler.addTask(wifiTask, WIFI_PERIOD);
+  dhtTaskId = scheduler.addTask(dhtTask, DHT_PERIOD);
+  scheduler.addTask(telemetryTask, TELEMETRY_PERIOD, telemetryWake);
+  scheduler.addTask(eepromTask, EEPROM_PERIOD);
+  scheduler.addTask(historyTask, HISTORY_PERIOD);
+  STATS_ONLY(scheduler.addTask(statsTask, STATS_PERIOD);)
+  scheduler.addTask(oledTask, OLED_PERIOD);
+  scheduler.addTask(logTask, LOG_PERIOD, logWake);
+}
+
+void loop() {
+  // runs all due tasks and sleeps until the next deadline or a wake event
+  scheduler.run();
 }
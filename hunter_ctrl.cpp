@@ -23,239 +23,356 @@
  */
  
 #include "HUNTER_CTRL.h"
-#include <vector>
-
-// definitions to adjust signaling on the HUNTER control line
-#define HUNTER_ONE HIGH         // This makes inverting the signal easy
-#define HUNTER_ZERO LOW
-#define START_INTERVAL 900
-#define SHORT_INTERVAL 208
-#define LONG_INTERVAL 1875
+#include "hunter_frame.h"
+#include "fixed_string.h"
+#include "logger.h"
 
 // Forward declarations
 /*!
  *  @brief  Stops the specified Hunter zone.
+ *  @param  tx    The transmitter to send the frame.
  *  @param  zone  The zone to stop.
+ *  @return True if the frame is going out.
  */
-void HunterStop(byte zone);
+bool HunterStop(HUNTER_BUS& tx, byte zone);
 
 /*!
  *  @brief  Starts the specified Hunter zone for a given time.
+ *  @param  tx    The transmitter to send the frame.
  *  @param  zone  The zone to start.
  *  @param  time  The duration to run the zone.
+ *  @return True if the frame is going out.
  */
-void HunterStart(byte zone, byte time);
+bool HunterStart(HUNTER_BUS& tx, byte zone, byte time);
 
 /*!
  *  @brief  Starts a Hunter program.
+ *  @param  tx   The transmitter to send the frame.
  *  @param  num  The program number to start.
+ *  @return True if the frame is going out.
  */
-void HunterProgram(byte num);
+bool HunterProgram(HUNTER_BUS& tx, byte num);
 
 /*!
- *  @brief  Sets a bitfield in a vector of bytes.
- *  @param  bits  The vector of bytes.
- *  @param  pos   The position to start setting bits.
- *  @param  val   The value to set.
- *  @param  len   The length of the bitfield.
+ *  @brief  Hands a frame over to the transmitter, does not wait for the frame to go out.
+ *  @param  tx     The transmitter to send the frame.
+ *  @param  frame  The encoded frame to write.
+ *  @return True if the transmitter accepted the frame.
  */
-void HunterBitfield(std::vector<byte>& bits, byte pos, byte val, byte len);
+bool HunterWrite(HUNTER_BUS& tx, const HUNTER_FRAME& frame);
+
+
+/*********************************************************
+   Class functions */
 
 /*!
- *  @brief  Writes a buffer to the Hunter controller.
- *  @param  buffer    The buffer to write.
- *  @param  extrabit  An extra bit to write.
+ *  @brief  Initializes a new HUNTER class.
+ *  @param  oled        Pointer to the OLED display object, not used by NULL_DISPLAY.
+ *  @param  appData     Pointer to the application data object, must be valid.
+ *  @param  controller  Index of the controller, selects the queued commands.
+ *  @param  remPin      GPIO connected to the REM line of the controller.
+ *  @param  pumpPin     GPIO switching the pump of the controller or NO_PUMP, not used by NULL_PUMP.
  */
-void HunterWrite(std::vector<byte> buffer, bool extrabit);
+template <class Display, class Pump>
+void HUNTER_CTRL<Display, Pump>::initialize(OLED* oled, APP_DATA* appData, const byte controller, const uint8_t remPin, const uint8_t pumpPin) {
+  this->appData = appData;
+  this->controller = controller;
+  display.begin(oled);
+
+  // Bus Port, see HUNTER_PINS in hunter_ctrl.h
+  tx.begin(remPin);
+
+  // last command before a reset, restored from RTC memory by appData
+  lastCmd = appData->getLastHunterCmd(controller);
+  if (lastCmd.zone || lastCmd.program) {
+    display.hunterInfo(lastCmd.zone, lastCmd.time, (lastCmd.type == HUNTER_CMD_TYPE::PROGRAM) ? lastCmd.program : 0);
+  }
+
+  // Set the pump to its default value
+  pump.begin(pumpPin, PUMP_PIN_DEFAULT);
+}
 
 /*!
- *  @brief  Sets the Hunter signal to low.
+ *  @brief  Starts a watering zone for a specified time.
+ *  @param  zone  The zone number.
+ *  @param  time  The duration in minutes.
+ *  @return True if the frame is going out, false if the bus is busy or the params are invalid.
  */
-void HunterLow(void);
+template <class Display, class Pump>
+boolean HUNTER_CTRL<Display, Pump>::startZone(const int zone, const int time) {
+  if (!tx.canSend()) {
+    return false;
+  }
+  // the pump only follows a frame that is going out, an invalid command leaves it as it is
+  if ((zone < 1) || (zone > HUNTER_MAX_ZONE) || (time < 0) || (time > HUNTER_MAX_TIME)) {
+    LOG_WARN("invalid zone %d or time %d", zone, time);
+    return false;
+  }
+  if (!HunterStart(tx, (byte)zone, (byte)time)) {
+    return false;
+  }
+  pump.set(time != 0);
+
+  FIXED_STRING<MAX_CHAR_IN_LINE> msg;
+  msg.format("Watering zone %d -> %d min", zone, time);
+  LOG_INFO("%s", msg.c_str());
+  display.action(msg.c_str());
+  display.hunterInfo(zone, time);
+  return true;
+}
 
 /*!
- *  @brief  Sets the Hunter signal to high.
+ *  @brief  Starts a watering program.
+ *  @param  programID  The ID of the program to start.
+ *  @return True if the frame is going out, false if the bus is busy or the program is invalid.
  */
-void HunterHigh(void);
-
-
-/*********************************************************
-   Class functions */
+template <class Display, class Pump>
+boolean HUNTER_CTRL<Display, Pump>::startProgram(const int programID) {
+  if (!tx.canSend()) {
+    return false;
+  }
+  FIXED_STRING<MAX_CHAR_IN_LINE> msg;
+  msg.format("Watering prog %d ...", programID);
+  LOG_INFO("%s", msg.c_str());
+  display.action(msg.c_str());
+  display.hunterInfo(0, 0, programID);
+  return HunterProgram(tx, programID);
+}
 
 /*!
- *  @brief  Initializes a new HUNTER class.
- *  @param  oled     Pointer to the OLED display object.
- *  @param  appData  Pointer to the application data object.
+ *  @brief  Observes the transmitter and drains the command queue, shall be called periodically.
+ *
+ *  As soon as the bus is free and no other bus is sending, the next command queued for this
+ *  controller is sent, invalid commands are skipped.
+ *  The watering flags are cleared when the queues of all controllers are empty.
  */
-void HUNTER_CTRL::initialize(OLED* oled, APP_DATA* appData) {
-  this->oled = oled;
-  this->appData = appData;
+template <class Display, class Pump>
+void HUNTER_CTRL<Display, Pump>::loop() {
+  if (tx.frameDone()) {
+    LOG_DEBUG("Hunter frame sent");
+    STATS_RECORD(HUNTER_FRAME, tx.getFrameDuration());
+    STATS_RECORD(HUNTER_JITTER, tx.getMaxJitter());
+  }
+  if (appData->getHunterPlanVersion(controller) != planVersion) {
+    startPlan();
+  }
 
-  if (USE_PUMP == true) {
-    // Define outputs for pump control and bus communication to X-Core controller
-    pinMode(PUMP_PIN, OUTPUT); // GPIO5 to switch the pump
-    pinMode(HUNTER_PIN, OUTPUT); // Bus Port, see value of HUNTER_PIN in hunter.h
+  if (appData->getHunterCmdOverflows(controller) != reportedOverflows) {
+    reportedOverflows = appData->getHunterCmdOverflows(controller);
+    LOG_WARN("hunter command queue %u overflow, dropped: %lu", controller + 1, (unsigned long)reportedOverflows);
+    display.action("Command queue full!");
+  }
 
-    // Set PUMP_PIN to default value
-    if (PUMP_PIN_DEFAULT) {
-      digitalWrite(PUMP_PIN, HIGH);
-    } else {
-      digitalWrite(PUMP_PIN, LOW);
+  HUNTER_CMD cmd;
+  while (tx.canSend() && appData->popHunterCmd(controller, cmd)) {
+    if (isRedundant(cmd)) {
+      // nothing changes on the bus, a running plan goes on
+      LOG_INFO("hunter command repeats the bus state, not sent");
+      skippedCount++;
+      continue;
+    }
+    if (planCount) {
+      // a single command takes over the bus
+      endPlan("Plan cancelled");
     }
+    execute(cmd);
+  }
+  if (appData->getHunterCmdCount() == 0) {
+    appData->clearNewDataFlag(DATA_UPDATE::HUNTER_ZONE_UPDATED);
+    appData->clearNewDataFlag(DATA_UPDATE::HUNTER_PROGRAM_UPDATED);
   }
+  if (planCount && tx.canSend() && ((int32_t)(millis() - stepDue) >= 0)) {
+    runPlanStep();
+  }
+  appData->saveRuntimeState();
 }
 
 /*!
- *  @brief  Switches the pump on or off.
- *  @param  onOff  Boolean indicating whether to turn the pump on or off.
+ *  @brief  Checks for pending work without doing it, cheap enough to be polled.
+ *  @return True if a frame has completed or a queued command can be sent.
  */
-void HUNTER_CTRL::switchPump(boolean onOff) {
-  if (USE_PUMP == true) {
-    // Set GPIO5 to control the pump and set flag to send a message to the X-Core controller 
-    if (onOff) {
-      Serial.println("Set GPIO5 high.");
-      digitalWrite(5, HIGH); 
-    } else {
-      Serial.println("Set GPIO5 low.");
-      digitalWrite(5, LOW);
-    }
+template <class Display, class Pump>
+boolean HUNTER_CTRL<Display, Pump>::hasWork() const {
+  if (tx.isDone()) {
+    return true;
+  }
+  if (!tx.canSend()) {
+    return false;
   }
+  return (appData->getHunterCmdCount(controller) > 0) || (appData->getHunterPlanVersion(controller) != planVersion)
+      || (planCount && ((int32_t)(millis() - stepDue) >= 0));
 }
 
 /*!
- *  @brief  Starts a watering zone for a specified time.
- *  @param  zone  The zone number.
- *  @param  time  The duration in minutes.
+ *  @brief  Sends a queued watering command.
+ *  @param  cmd  The command.
+ *  @return True if the frame is going out.
  */
-void HUNTER_CTRL::startZone(const int zone, const int time) {
-  String msg = "Watering zone " + (String)zone + " -> " + (String)time + (String)" min";
-  Serial.println(msg);
-  if (oled) {
-    oled->updateAction(msg.c_str());
-    oled->updateHunterInfo(zone, time);
+template <class Display, class Pump>
+boolean HUNTER_CTRL<Display, Pump>::execute(const HUNTER_CMD& cmd) {
+  boolean sent;
+  if (cmd.type == HUNTER_CMD_TYPE::PROGRAM) {
+    sent = startProgram(cmd.program);
+  } else {
+    sent = startZone(cmd.zone, cmd.time);
+  }
+  if (sent) {
+    noteSent(cmd);
+    sentCount++;
+    STATS_RECORD(CMD_LATENCY, micros() - cmd.received);
   }
-  
-  if (time) {switchPump(true);} else {switchPump(false);}
-  HunterStart((byte)zone, (byte)time);
+  return sent;
 }
 
 /*!
- *  @brief  Starts a watering program.
- *  @param  programID  The ID of the program to start.
+ *  @brief  Checks if a command would only repeat the state of the bus.
+ *
+ *  The X-Core runs one zone at a time. A stop is redundant if the zone is known not to run,
+ *  a start or program if it equals the last frame within HUNTER_DEDUPE_WINDOW s and its zone
+ *  still runs. The window is taken from the stamps of the sender if both commands have one.
+ *  A command stamped before the last frame is late or reordered, it is not taken for a repetition
+ *  and sent like a new one, the stamps of different senders need not agree.
+ *
+ *  @param  cmd  The command.
+ *  @return True if the frame shall not be sent.
  */
-void HUNTER_CTRL::startProgram(const int programID) {
-  String msg = "Watering prog " + (String)programID + " ...";
-  Serial.println(msg);
-  if (oled) {
-    oled->updateAction(msg.c_str());
-    oled->updateHunterInfo(0, 0, programID);
+template <class Display, class Pump>
+boolean HUNTER_CTRL<Display, Pump>::isRedundant(const HUNTER_CMD& cmd) const {
+  if (cmd.force) {
+    return false;
+  }
+  if ((cmd.type == HUNTER_CMD_TYPE::ZONE) && (cmd.time == 0)) {
+    return zoneKnown && !isZoneRunning(cmd.zone);
+  }
+  if (!lastKnown || (cmd.type != lastCmd.type)) {
+    return false;
+  }
+  int32_t age = (cmd.stamp && lastCmd.stamp) ? (int32_t)(cmd.stamp - lastCmd.stamp) : (int32_t)((millis() - lastSent) / 1000);
+  if (age < 0) {
+    LOG_WARN("hunter command stamped %ld s before the last frame, sent as new", (long)-age);
+    return false;
   }
-  HunterProgram(programID);
+  if (age >= HUNTER_DEDUPE_WINDOW) {
+    return false;
+  }
+  if (cmd.type == HUNTER_CMD_TYPE::PROGRAM) {
+    return cmd.program == lastCmd.program;
+  }
+  return (cmd.zone == lastCmd.zone) && (cmd.time == lastCmd.time) && isZoneRunning(cmd.zone);
 }
 
-/*   endClass functions 
-******************************************************** */
+/*!
+ *  @brief  Checks if a zone runs according to the frames sent.
+ *  @param  zone  The zone.
+ *  @return True if the zone has been started and its time is not over.
+ */
+template <class Display, class Pump>
+boolean HUNTER_CTRL<Display, Pump>::isZoneRunning(const byte zone) const {
+  return zoneKnown && runningZone && (runningZone == zone) && ((int32_t)(millis() - runningUntil) < 0);
+}
 
+/*!
+ *  @brief  Records a command gone out on the bus and the zone state it leads to.
+ *  @param  cmd  The command.
+ */
+template <class Display, class Pump>
+void HUNTER_CTRL<Display, Pump>::noteSent(const HUNTER_CMD& cmd) {
+  lastCmd = cmd;
+  lastKnown = true;
+  lastSent = millis();
+  appData->setLastHunterCmd(cmd);
+  if (cmd.type == HUNTER_CMD_TYPE::PROGRAM) {
+    zoneKnown = false;    // the program runs its own zones
+  } else if (cmd.time) {
+    zoneKnown = true;
+    runningZone = cmd.zone;
+    runningUntil = lastSent + cmd.time * 60000UL;
+  } else if (cmd.zone == runningZone) {
+    runningZone = 0;
+  }
+}
 
-/////////////////////////////////////////////////////////////////////////////
-// Function: HunterBitfield
-// Description: Set a value with an arbitrary bit width to a bit position
-// within a blob
-// Arguments: bits - blob to write the value to
-// pos - bit position within the blob
-// val - value to write
-// len - len in bits of the value
-/////////////////////////////////////////////////////////////////////////////
-void HunterBitfield(std::vector<byte>& bits, byte pos, byte val, byte len) {
-  while (len > 0) {
-    if (val & 0x1) {
-      bits[pos / 8] = bits[pos / 8] | 0x80 >> (pos % 8);
-    } else {
-      bits[pos / 8] = bits[pos / 8] & ~(0x80 >> (pos % 8));
+/*!
+ *  @brief  Takes the latest run plan of this controller from appData, its running plan is replaced.
+ *
+ *  Every controller has its own plan, the plans of the other controllers go on.
+ *  The pump is switched on for the whole plan, an empty plan only cancels.
+ */
+template <class Display, class Pump>
+void HUNTER_CTRL<Display, Pump>::startPlan() {
+  planVersion = appData->getHunterPlanVersion(controller);
+  appData->clearNewDataFlag(DATA_UPDATE::HUNTER_PLAN_UPDATED);
+  const HUNTER_PLAN& plan = appData->getHunterPlan(controller);
+  if (plan.count == 0) {
+    if (planCount) {
+      endPlan("Plan cancelled");
     }
-    len--;
-    val = val >> 1;
-    pos++;
+    return;
+  }
+  if (planCount) {
+    LOG_INFO("Plan replaced");
   }
+  LOG_INFO("Starting plan with zones: %u", plan.count);
+  planCount = plan.count;
+  planStep = 0;
+  stepDue = millis();
+  pump.set(true);
 }
 
-/////////////////////////////////////////////////////////////////////////////
-// Function: HunterLow
-// Description: writes a low bit on the bus
-// Arguments: none
-/////////////////////////////////////////////////////////////////////////////
-void HunterLow(void) {
-  digitalWrite(HUNTER_PIN, HUNTER_ONE);
-  delayMicroseconds(SHORT_INTERVAL);  //microseconds
-  digitalWrite(HUNTER_PIN, HUNTER_ZERO);
-  delayMicroseconds(LONG_INTERVAL);  //microseconds
+/*!
+ *  @brief  Ends the running plan and switches the pump off.
+ *  @param  reason  Message for serial and OLED.
+ */
+template <class Display, class Pump>
+void HUNTER_CTRL<Display, Pump>::endPlan(const char* reason) {
+  LOG_INFO("%s", reason);
+  display.action(reason);
+  planCount = 0;
+  planStep = 0;
+  pump.set(false);
 }
 
-/////////////////////////////////////////////////////////////////////////////
-// Function: HunterHigh
-// Description: writes a high bit on the bus
-// Arguments: none
-/////////////////////////////////////////////////////////////////////////////
-void HunterHigh(void) {
-  digitalWrite(HUNTER_PIN, HUNTER_ONE);
-  delayMicroseconds(LONG_INTERVAL);  //microseconds
-  digitalWrite(HUNTER_PIN, HUNTER_ZERO);
-  delayMicroseconds(SHORT_INTERVAL);  //microseconds
+/*!
+ *  @brief  Sends the pre-encoded frame of the next plan step, the plan ends after the time of the last zone.
+ */
+template <class Display, class Pump>
+void HUNTER_CTRL<Display, Pump>::runPlanStep() {
+  if (planStep >= planCount) {
+    endPlan("Plan done");
+    return;
+  }
+  const HUNTER_PLAN_STEP& step = appData->getHunterPlan(controller).steps[planStep];
+  if (!HunterWrite(tx, step.frame)) {
+    return;   // bus busy, tried again with the next loop
+  }
+  FIXED_STRING<MAX_CHAR_IN_LINE> msg;
+  msg.format("Plan %d/%d zone %d", planStep + 1, planCount, step.zone);
+  LOG_INFO("%s", msg.c_str());
+  display.action(msg.c_str());
+  display.hunterInfo(step.zone, step.minutes);
+  noteSent({ HUNTER_CMD_TYPE::ZONE, step.zone, step.minutes, 0, controller });
+  sentCount++;
+  planStep++;
+  // the gap of the last step does not delay the end of the plan
+  stepDue = millis() + step.minutes * 60000UL + ((planStep < planCount) ? step.gap * 1000UL : 0);
 }
 
+// the configured policies, see XCORE_CTRL
+template class HUNTER_CTRL<HUNTER_DISPLAY, HUNTER_PUMP>;
+
+/*   endClass functions 
+******************************************************** */
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Function: HunterWrite
-// Description: Write the bit sequence out of the bus
-// Arguments: buffer - blob containing the bits to transmit
-// extrabit - if true, then write an extra 1 bit
+// Description: Hand the encoded frame over to the bus transmitter,
+// the reset, start and stop pulses are added by the transmitter
+// Arguments: tx - transmitter driving the bus
+// frame - frame containing the bits to transmit and the extrabit flag
 /////////////////////////////////////////////////////////////////////////////
-void HunterWrite(std::vector<byte> buffer, bool extrabit) {
-  // Bus start sequence
-  //_flexwire.invert(false);
-  //delay(325);
-  //_flexwire.invert(true);
-  //delay(65);
-
-  // Resetimpulse
-  digitalWrite(HUNTER_PIN, HUNTER_ONE);
-  delay(325);  //milliseconds
-  digitalWrite(HUNTER_PIN, HUNTER_ZERO);
-  delay(65);  //milliseconds
-
-  // Write the start pulse
-  //_flexwire.invert(false);
-  //udelay(900);
-  //_flexwire.invert(true);
-
-  // Startimpulse
-  digitalWrite(HUNTER_PIN, HUNTER_ONE);
-  delayMicroseconds(START_INTERVAL);  //microseconds
-  digitalWrite(HUNTER_PIN, HUNTER_ZERO);
-  delayMicroseconds(SHORT_INTERVAL);  //microseconds
-
-  // Write the bits out
-  //_flexwire.write(buffer);
-  for (auto& sendByte : buffer) {
-    for (byte inner = 0; inner < 8; inner++) {
-      // Send high order bits first
-      if (sendByte & 0x80) {
-        HunterHigh();
-      } else {
-        HunterLow();
-      }
-      sendByte <<= 1;
-    }
-  }
-
-  // Include an extra 1 bit
-  if (extrabit) {
-    //_flexwire.writebit(true);
-    HunterHigh();
-  }
-
-  // Write the stop pulse
-  //_flexwire.writebit(false);
-  HunterLow();
+bool HunterWrite(HUNTER_BUS& tx, const HUNTER_FRAME& frame) {
+  return tx.send(frame.data.data(), frame.len, frame.extrabit);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -264,63 +381,21 @@ void HunterWrite(std::vector<byte> buffer, bool extrabit) {
 // Arguments: zone - zone number (1-48)
 // time - time in minutes (0-240)
 /////////////////////////////////////////////////////////////////////////////
-void HunterStart(byte zone, byte time) {
-
-  Serial.print("HunterStart zone ");
-  Serial.print(zone);
-  Serial.print(" for ");
-  Serial.print(time);
-  Serial.println(" min");
-
-  // Start out with a base frame
-  std::vector<byte> buffer = { 0xff, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x04, 0x00, 0x00, 0x01, 0x00, 0x01, 0xb8, 0x3f };
-
-  if (zone < 1 || zone > 48) {
-    Serial.println("invalid zone");
-    return;
-  }
+bool HunterStart(HUNTER_BUS& tx, byte zone, byte time) {
+  LOG_DEBUG("HunterStart zone %u for %u min", zone, time);
 
-  if (time < 0 || time > 240) {
-    Serial.println("invalid time");
-    return;
+  if (zone < 1 || zone > HUNTER_MAX_ZONE) {
+    LOG_WARN("invalid zone");
+    return false;
   }
 
-  // The bus protocol is a little bizzare, not sure why
-
-  // Bits 9:10 are 0x1 for zones > 12 and 0x2 otherwise
-  if (zone > 12) {
-    HunterBitfield(buffer, 9, 0x1, 2);
-  } else {
-    HunterBitfield(buffer, 9, 0x2, 2);
+  if (time > HUNTER_MAX_TIME) {
+    LOG_WARN("invalid time");
+    return false;
   }
 
-  // Zone + 0x17 is at bits 23:29 and 36:42
-  HunterBitfield(buffer, 23, zone + 0x17, 7);
-  HunterBitfield(buffer, 36, zone + 0x17, 7);
-
-  // Zone + 0x23 is at bits 49:55 and 62:68
-  HunterBitfield(buffer, 49, zone + 0x23, 7);
-  HunterBitfield(buffer, 62, zone + 0x23, 7);
-
-  // Zone + 0x2f is at bits 75:81 and 88:94
-  HunterBitfield(buffer, 75, zone + 0x2f, 7);
-  HunterBitfield(buffer, 88, zone + 0x2f, 7);
-
-  // Time is encoded in three places and broken up by nibble
-  // Low nibble: bits 31:34, 57:60, and 83:86
-  // High nibble: bits 44:47, 70:73, and 96:99
-  HunterBitfield(buffer, 31, time, 4);
-  HunterBitfield(buffer, 44, time >> 4, 4);
-  HunterBitfield(buffer, 57, time, 4);
-  HunterBitfield(buffer, 70, time >> 4, 4);
-  HunterBitfield(buffer, 83, time, 4);
-  HunterBitfield(buffer, 96, time >> 4, 4);
-
-  // Bottom nibble of zone - 1 is at bits 109:112
-  HunterBitfield(buffer, 109, zone - 1, 4);
-
-  // Write the bits out of the bus
-  HunterWrite(buffer, true);
+  // Write the bits out of the bus, the frame is encoded on the stack
+  return HunterWrite(tx, hunterZoneFrame(zone, time));
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -328,11 +403,9 @@ void HunterStart(byte zone, byte time) {
 // Description: Stop all zones
 // Arguments: None
 /////////////////////////////////////////////////////////////////////////////
-void HunterStop(byte zone) {
-  Serial.print("HunterStop zone ");
-  Serial.print(zone);
-  Serial.print(": ");
-  HunterStart(zone, 0);
+bool HunterStop(HUNTER_BUS& tx, byte zone) {
+  LOG_DEBUG("HunterStop zone %u", zone);
+  return HunterStart(tx, zone, 0);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -340,16 +413,12 @@ void HunterStop(byte zone) {
 // Description: Run a program
 // Arguments: num - program number (1-4)
 /////////////////////////////////////////////////////////////////////////////
-void HunterProgram(byte num) {
-  // Start with a basic program frame
-  std::vector<byte> buffer = { 0xff, 0x40, 0x03, 0x96, 0x09, 0xbd, 0x7f };
-
-  if (num < 1 || num > 4) {
-    Serial.println("invalid program");
-    return;
+bool HunterProgram(HUNTER_BUS& tx, byte num) {
+  if (num < 1 || num > HUNTER_MAX_PROGRAM) {
+    LOG_WARN("invalid program");
+    return false;
   }
 
-  // Program number - 1 is at bits 31:32
-  HunterBitfield(buffer, 31, num - 1, 2);
-  HunterWrite(buffer, false);
+  // program frames are built by the compiler
+  return HunterWrite(tx, HUNTER_PROGRAM_FRAMES[num - 1]);
 }
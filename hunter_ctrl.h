@@ -14,29 +14,88 @@
 #include <Arduino.h>
 #include "app_data.h"
 #include "oled.h"
+#include <type_traits>
+#include "hunter_tx.h"
+#include "hunter_i2s.h"
+#include "hunter_policy.h"
 
-#define USE_PUMP          false  // set true to control a pump
 #define PUMP_PIN_DEFAULT  false  // Set to true to set PUMP_PIN as On by default
 #define PUMP_PIN          D1     // GPIO5 = 5 = D1
 
-#define HUNTER_PIN     D0 // GPIO pin 16
+#define HUNTER_PIN     D0 // GPIO pin 16, HUNTER_I2S_PIN (GPIO3/RX) selects the hardware timed I2S output
+#define HUNTER_DEDUPE_WINDOW  60   // s, a command repeating the last one within this time is not sent again
+// REM line and pump of each controller, the index is the controller of the commands, see HUNTER_CONTROLLERS
+#define HUNTER_PINS    { HUNTER_PIN, D6, D7, D8 }
+#define PUMP_PINS      { PUMP_PIN, NO_PUMP, NO_PUMP, NO_PUMP }
 //#define ENABLE_PIN 14 // D7 - not used
 //#define LED_PIN 2 // LED on D1 mini
 
+// the I2S output exists only on GPIO3, every other pin is driven by the timer1 ISR
+typedef std::conditional<HUNTER_PIN == HUNTER_I2S_PIN, HUNTER_I2S_TX, HUNTER_TX>::type HUNTER_BUS;
+static_assert((HUNTER_PIN != HUNTER_I2S_PIN) || (HUNTER_CONTROLLERS == 1), "the I2S output drives a single bus");
+
+/*!
+ *  @brief  Class driving one X-Core controller on its own REM line.
+ *
+ *  Display and Pump are policies, see hunter_policy.h. NULL_DISPLAY and NULL_PUMP compile the
+ *  OLED and the pump out completely, no pointer or flag is checked on the way to the bus.
+ *
+ *  Every instance takes the commands queued for its controller. The transmitters of all
+ *  instances share timer1, a frame is only accepted while no other bus is sending, so the
+ *  frames of the buses are interleaved one after the other.
+ *  A command repeating the state of the bus, e.g. the same start again or a stop of a zone
+ *  that is not running, is acknowledged without sending its frame, unless it is forced.
+ */
+template <class Display, class Pump>
 class HUNTER_CTRL {
 public:
 	// constructor
   HUNTER_CTRL() {};
   // public methods
-  void initialize(OLED* oled, APP_DATA* appData);
-  void startZone(const int zone, const int time);
-  void startProgram(const int programID);
+  void    initialize(OLED* oled, APP_DATA* appData, const byte controller, const uint8_t remPin, const uint8_t pumpPin);
+  boolean startZone(const int zone, const int time);
+  boolean startProgram(const int programID);
+  boolean isBusy() const { return tx.isBusy(); }
+  byte    getController() const { return controller; }
+  boolean hasWork() const;
+  void    loop();
+  const HUNTER_CMD& getLastCmd() const { return lastCmd; }
+  uint16_t getSentCount() const { return sentCount; }
+  uint16_t getSkippedCount() const { return skippedCount; }
+  boolean isPlanRunning() const { return planCount > 0; }
 
 private:
-  OLED*     oled;
-  APP_DATA* appData;
-  void switchPump(boolean onOff);
+  Display   display;
+  Pump      pump;
+  APP_DATA* appData = nullptr;
+  HUNTER_BUS tx;
+  byte      controller = 0;     // index of the queue and the plan taken from appData
+  uint16_t  reportedOverflows = 0;
+  HUNTER_CMD lastCmd = {};      // last command gone out on the bus
+  uint16_t  sentCount = 0;      // commands gone out since start, wraps around
+  uint16_t  skippedCount = 0;   // redundant commands not sent since start, wraps around
+  boolean   lastKnown = false;  // lastCmd went out in this run, at lastSent
+  uint32_t  lastSent = 0;       // millis() of the last frame
+  boolean   zoneKnown = false;  // the running zone is known, not after start or a program
+  byte      runningZone = 0;    // zone started by the last frames, 0 if none is running
+  uint32_t  runningUntil = 0;   // millis() the running zone stops by itself
+  uint16_t  planVersion = 0;    // version of the run plan in appData last taken
+  byte      planCount = 0;      // steps of the running plan, 0 if no plan runs
+  byte      planStep = 0;       // next step of the running plan
+  uint32_t  stepDue = 0;        // millis() the next step is due
+  boolean execute(const HUNTER_CMD& cmd);
+  boolean isRedundant(const HUNTER_CMD& cmd) const;
+  boolean isZoneRunning(const byte zone) const;
+  void    noteSent(const HUNTER_CMD& cmd);
+  void    startPlan();
+  void    endPlan(const char* reason);
+  void    runPlanStep();
 
 };
 
+// components of this application, instantiated in hunter_ctrl.cpp
+typedef OLED_DISPLAY  HUNTER_DISPLAY;   // NULL_DISPLAY without an OLED
+typedef NULL_PUMP     HUNTER_PUMP;      // PIN_PUMP switches a relay on the PUMP_PINS
+typedef HUNTER_CTRL<HUNTER_DISPLAY, HUNTER_PUMP> XCORE_CTRL;
+
 #endif // HUNTER_CTRL_H
@@ -0,0 +1,232 @@
+/*!
+ *  @file hunter_frame.h
+ *
+ *  This is a compile-time encoder for frames on the Hunter REM line.
+ *
+ *  All functions are constexpr and work on fixed-size std::array, a frame can be built
+ *  by the compiler or on demand at runtime without touching the heap.
+ *
+ *  It has been adapted from
+ * 		- Claude <https://www.loullingen.lu/projekte/Hunter/index.php>
+ *    - Sebastian <https://github.com/seb821/OpenSprinkler-Firmware-Hunter>
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HUNTER_FRAME_H
+#define HUNTER_FRAME_H
+
+#include <Arduino.h>
+#include <array>
+#include "hunter_tx.h"
+
+#define HUNTER_MAX_ZONE     48
+#define HUNTER_MAX_TIME     240   // minutes
+#define HUNTER_MAX_PROGRAM  4
+
+#define ZONE_FRAME_LEN      15
+#define PROGRAM_FRAME_LEN   7
+
+/*!
+ *  @brief  Struct for an encoded frame, len is 0 for an invalid frame.
+ */
+typedef struct {
+  std::array<byte, HUNTER_MAX_FRAME>  data;
+  byte                                len;
+  bool                                extrabit;
+} HUNTER_FRAME;
+
+/*!
+ *  @brief  Sets a value with an arbitrary bit width to a bit position within a frame.
+ *  @param  frame  frame to write the value to
+ *  @param  pos    bit position within the frame
+ *  @param  val    value to write, low order bit first
+ *  @param  len    len in bits of the value
+ */
+constexpr void hunterBitfield(HUNTER_FRAME& frame, byte pos, byte val, byte len) {
+  while (len > 0) {
+    if (val & 0x1) {
+      frame.data[pos / 8] = frame.data[pos / 8] | (0x80 >> (pos % 8));
+    } else {
+      frame.data[pos / 8] = frame.data[pos / 8] & ~(0x80 >> (pos % 8));
+    }
+    len--;
+    val = val >> 1;
+    pos++;
+  }
+}
+
+/*!
+ *  @brief  Encodes the frame to start a zone.
+ *  @param  zone  zone number (1-48)
+ *  @param  time  time in minutes (0-240), 0 stops the zone
+ *  @return The frame, len is 0 if zone or time are invalid.
+ */
+constexpr HUNTER_FRAME hunterZoneFrame(byte zone, byte time) {
+  // Start out with a base frame
+  HUNTER_FRAME frame = {{ 0xff, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x04, 0x00, 0x00, 0x01, 0x00, 0x01, 0xb8, 0x3f },
+                        ZONE_FRAME_LEN, true };
+
+  if (zone < 1 || zone > HUNTER_MAX_ZONE || time > HUNTER_MAX_TIME) {
+    frame.len = 0;
+    return frame;
+  }
+
+  // The bus protocol is a little bizzare, not sure why
+
+  // Bits 9:10 are 0x1 for zones > 12 and 0x2 otherwise
+  hunterBitfield(frame, 9, (zone > 12) ? 0x1 : 0x2, 2);
+
+  // Zone + 0x17 is at bits 23:29 and 36:42
+  hunterBitfield(frame, 23, zone + 0x17, 7);
+  hunterBitfield(frame, 36, zone + 0x17, 7);
+
+  // Zone + 0x23 is at bits 49:55 and 62:68
+  hunterBitfield(frame, 49, zone + 0x23, 7);
+  hunterBitfield(frame, 62, zone + 0x23, 7);
+
+  // Zone + 0x2f is at bits 75:81 and 88:94
+  hunterBitfield(frame, 75, zone + 0x2f, 7);
+  hunterBitfield(frame, 88, zone + 0x2f, 7);
+
+  // Time is encoded in three places and broken up by nibble
+  // Low nibble: bits 31:34, 57:60, and 83:86
+  // High nibble: bits 44:47, 70:73, and 96:99
+  hunterBitfield(frame, 31, time, 4);
+  hunterBitfield(frame, 44, time >> 4, 4);
+  hunterBitfield(frame, 57, time, 4);
+  hunterBitfield(frame, 70, time >> 4, 4);
+  hunterBitfield(frame, 83, time, 4);
+  hunterBitfield(frame, 96, time >> 4, 4);
+
+  // Bottom nibble of zone - 1 is at bits 109:112
+  hunterBitfield(frame, 109, zone - 1, 4);
+
+  return frame;
+}
+
+/*!
+ *  @brief  Encodes the frame to run a program.
+ *  @param  num  program number (1-4)
+ *  @return The frame, len is 0 if num is invalid.
+ */
+constexpr HUNTER_FRAME hunterProgramFrame(byte num) {
+  // Start with a basic program frame
+  HUNTER_FRAME frame = {{ 0xff, 0x40, 0x03, 0x96, 0x09, 0xbd, 0x7f }, PROGRAM_FRAME_LEN, false };
+
+  if (num < 1 || num > HUNTER_MAX_PROGRAM) {
+    frame.len = 0;
+    return frame;
+  }
+
+  // Program number - 1 is at bits 31:32
+  hunterBitfield(frame, 31, num - 1, 2);
+  return frame;
+}
+
+/*!
+ *  @brief  Builds the table of all program frames.
+ *  @return Frames of program 1-4 at index 0-3.
+ */
+constexpr std::array<HUNTER_FRAME, HUNTER_MAX_PROGRAM> hunterProgramTable() {
+  std::array<HUNTER_FRAME, HUNTER_MAX_PROGRAM> table = {};
+  for (byte i = 0; i < HUNTER_MAX_PROGRAM; i++) {
+    table[i] = hunterProgramFrame(i + 1);
+  }
+  return table;
+}
+
+// program frames are fixed, they are built by the compiler
+inline constexpr std::array<HUNTER_FRAME, HUNTER_MAX_PROGRAM> HUNTER_PROGRAM_FRAMES = hunterProgramTable();
+
+/*!
+ *  @brief  Compares a frame with an expected byte sequence.
+ *  @param  frame     frame to check
+ *  @param  expected  expected bytes of the frame
+ *  @return True if all bytes are equal.
+ */
+template <size_t N>
+constexpr bool hunterFrameEquals(const HUNTER_FRAME& frame, const std::array<byte, N>& expected) {
+  if (frame.len != N) {
+    return false;
+  }
+  for (size_t i = 0; i < N; i++) {
+    if (frame.data[i] != expected[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// frames as sent by the former bit by bit encoder
+static_assert(hunterFrameEquals(hunterZoneFrame(1, 10), std::array<byte, ZONE_FRAME_LEN>{
+  0xff, 0x20, 0x00, 0x30, 0xb1, 0x80, 0x12, 0x2c, 0x90, 0x01, 0x8b, 0x0c, 0x01, 0xb8, 0x3f }), "zone frame 1/10");
+static_assert(hunterFrameEquals(hunterZoneFrame(13, 240), std::array<byte, ZONE_FRAME_LEN>{
+  0xff, 0x40, 0x00, 0x48, 0x12, 0x4f, 0x06, 0x04, 0x33, 0xc7, 0x81, 0x3c, 0xf1, 0xb9, 0xbf }), "zone frame 13/240");
+static_assert(hunterFrameEquals(hunterZoneFrame(12, 95), std::array<byte, ZONE_FRAME_LEN>{
+  0xff, 0x20, 0x01, 0x89, 0xfc, 0x4a, 0x7a, 0x7f, 0xd2, 0x9b, 0x9f, 0xdc, 0xa1, 0xbe, 0xbf }), "zone frame 12/95");
+static_assert(hunterFrameEquals(hunterZoneFrame(48, 0), std::array<byte, ZONE_FRAME_LEN>{
+  0xff, 0x40, 0x01, 0xc4, 0x1e, 0x20, 0x65, 0x07, 0x28, 0x1f, 0x41, 0xfa, 0x01, 0xbf, 0xbf }), "zone frame 48/0");
+static_assert(hunterFrameEquals(HUNTER_PROGRAM_FRAMES[0], std::array<byte, PROGRAM_FRAME_LEN>{
+  0xff, 0x40, 0x03, 0x96, 0x09, 0xbd, 0x7f }), "program frame 1");
+static_assert(hunterFrameEquals(HUNTER_PROGRAM_FRAMES[3], std::array<byte, PROGRAM_FRAME_LEN>{
+  0xff, 0x40, 0x03, 0x97, 0x89, 0xbd, 0x7f }), "program frame 4");
+static_assert(hunterZoneFrame(0, 0).len == 0 && hunterZoneFrame(HUNTER_MAX_ZONE + 1, 0).len == 0
+           && hunterZoneFrame(1, HUNTER_MAX_TIME + 1).len == 0 && hunterProgramFrame(0).len == 0, "invalid frames");
+
+/*!
+ *  @brief  Checks the pulse train of a frame, every bit is decoded from its pulse lengths.
+ *  @param  frame  frame to check
+ *  @return True if reset, start and stop pulse are in place and the decoded bits equal the frame.
+ */
+constexpr bool hunterWaveMatches(const HUNTER_FRAME& frame) {
+  const uint16_t bits = frame.len * 8;
+  const uint16_t edges = hunterEdgeCount(bits, frame.extrabit);
+  const byte* data = frame.data.data();
+  if ((hunterPulseLength(data, bits, frame.extrabit, 0) != RESET_INTERVAL * 1000UL)
+      || (hunterPulseLength(data, bits, frame.extrabit, 1) != RESET_PAUSE * 1000UL)
+      || (hunterPulseLength(data, bits, frame.extrabit, 2) != START_INTERVAL)
+      || (hunterPulseLength(data, bits, frame.extrabit, 3) != SHORT_INTERVAL)) {
+    return false;
+  }
+  for (uint16_t edge = EDGES_BEFORE_DATA; edge < edges; edge += 2) {
+    const uint32_t high = hunterPulseLength(data, bits, frame.extrabit, edge);
+    const uint32_t low = hunterPulseLength(data, bits, frame.extrabit, edge + 1);
+    // every bit takes the same time, only the duty cycle differs
+    if (((high != SHORT_INTERVAL) && (high != LONG_INTERVAL)) || (high + low != SHORT_INTERVAL + LONG_INTERVAL)) {
+      return false;
+    }
+    const uint16_t pos = (edge - EDGES_BEFORE_DATA) / 2;
+    const bool expected = (pos < bits) ? ((frame.data[pos / 8] >> (7 - pos % 8)) & 0x1) : (frame.extrabit && (pos == bits));
+    if ((high == LONG_INTERVAL) != expected) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ *  @brief  Gets the time a frame occupies the bus.
+ *  @param  frame  frame to send
+ *  @return The sum of all pulses in us.
+ */
+constexpr uint32_t hunterFrameDuration(const HUNTER_FRAME& frame) {
+  const uint16_t bits = frame.len * 8;
+  uint32_t duration = 0;
+  for (uint16_t edge = 0; edge < hunterEdgeCount(bits, frame.extrabit); edge++) {
+    duration += hunterPulseLength(frame.data.data(), bits, frame.extrabit, edge);
+  }
+  return duration;
+}
+
+// pulse train as driven by the timer1 ISR
+static_assert(hunterWaveMatches(hunterZoneFrame(1, 10)) && hunterWaveMatches(hunterZoneFrame(13, 240))
+           && hunterWaveMatches(hunterZoneFrame(48, 0)) && hunterWaveMatches(HUNTER_PROGRAM_FRAMES[0])
+           && hunterWaveMatches(HUNTER_PROGRAM_FRAMES[3]), "pulse train");
+// reset and start pulse 391.108 ms, 2.083 ms per bit incl. extra bit and stop bit
+static_assert(hunterFrameDuration(hunterZoneFrame(1, 10)) == 645234UL, "zone frame duration");
+static_assert(hunterFrameDuration(HUNTER_PROGRAM_FRAMES[0]) == 509839UL, "program frame duration");
+
+#endif // HUNTER_FRAME_H
@@ -0,0 +1,178 @@
+/*!
+ *  @file hunter_i2s.cpp
+ *
+ *  @mainpage  hardware timed transmitter for the HUNTER XCORE REM line.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  This class sends a frame on the REM line out of the I2S DMA buffers instead of driving the edges
+ *  from an ISR. The pulse train of hunter_wave.h is rounded to HUNTER_I2S_TICK us and expanded
+ *  word by word into the buffers, long pulses like the reset pulse are written as whole words.
+ *  The I2S output is started once by begin(), its DMA buffers are allocated there and never freed.
+ *  Between frames the driver plays silence, it zeroes every played buffer, the REM line stays low. A frame goes out this way
+ *    - send() writes the first HUNTER_I2S_DEPTH buffers, they are played right after the current one
+ *    - the driver calls onRefill() whenever a buffer has been played, it writes the next buffer
+ *    - the buffer of the last pulse is completed with silent words, the driver writes whole buffers only
+ *      and the next frame has to start on a buffer of its own
+ *    - the frame is done when that buffer has been played, at most one buffer (~8 ms) after the last pulse
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "hunter_i2s.h"
+#include <i2s.h>
+#include "logger.h"
+
+HUNTER_I2S_TX* HUNTER_I2S_TX::instance = nullptr;
+
+/*!
+ *  @brief  Assigns the REM pin and starts the I2S output, the bus is idle.
+ *  @param  pin  GPIO connected to the REM line of the X-Core, has to be HUNTER_I2S_PIN
+ */
+void HUNTER_I2S_TX::begin(const uint8_t pin) {
+  if (pin != HUNTER_I2S_PIN) {
+    LOG_ERROR("I2S output only on GPIO3");
+  }
+  this->pin = pin;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  state = HUNTER_TX_STATE::TX_IDLE;
+  // the driver allocates its DMA buffers here, once for the whole run
+  started = i2s_begin();
+  if (!started) {
+    LOG_ERROR("I2S init failed");
+    return;
+  }
+  i2s_set_rate(HUNTER_I2S_RATE);
+  instance = this;
+  i2s_set_callback(HUNTER_I2S_TX::onRefill);
+}
+
+/*!
+ *  @brief  Starts the transmission of a frame, returns right away.
+ *  @param  frame     The bytes to send, high order bit first.
+ *  @param  len       Number of bytes in frame, at most HUNTER_MAX_FRAME.
+ *  @param  extrabit  If true, an extra 1 bit is sent after the frame.
+ *  @return True if the frame was accepted, false if the output is still in use, the frame is too long
+ *          or the I2S output is not running.
+ */
+boolean HUNTER_I2S_TX::send(const byte* frame, const byte len, const bool extrabit) {
+  if (!started || (state != HUNTER_TX_STATE::TX_IDLE)) {
+    return false;
+  }
+  if (len > HUNTER_MAX_FRAME) {
+    LOG_ERROR("frame too long");
+    return false;
+  }
+  memcpy(this->frame, frame, len);
+  this->dataBits = len * 8;
+  this->extrabit = extrabit;
+  this->edgeCount = hunterEdgeCount(dataBits, extrabit);
+  this->edge = 0;
+  this->ticks = (hunterPulseLength(this->frame, dataBits, extrabit, 0) + HUNTER_I2S_TICK / 2) / HUNTER_I2S_TICK;
+  this->words = 0;
+  this->wordReady = false;
+  this->pending = 1;    // the buffer playing now
+
+  STATS_ONLY(frameStart = micros();)
+  // write the first buffers, the refill callback takes over, it must not run in between
+  noInterrupts();
+  this->state = HUNTER_TX_STATE::TX_BUSY;
+  fill();
+  interrupts();
+  return true;
+}
+
+/*!
+ *  @brief  Reports a completed frame once, the I2S output plays silence until the next frame.
+ *  @return True if a frame has completed since the last call.
+ */
+boolean HUNTER_I2S_TX::frameDone() {
+  if (state == HUNTER_TX_STATE::TX_DONE) {
+    state = HUNTER_TX_STATE::TX_IDLE;
+    return true;
+  }
+  return false;
+}
+
+// ======= private functions ===================================================
+
+/*!
+ *  @brief  Refill callback of the I2S driver, called from its ISR when a buffer has been played.
+ */
+void IRAM_ATTR HUNTER_I2S_TX::onRefill() {
+  if (instance && (instance->state == HUNTER_TX_STATE::TX_BUSY)) {
+    if (instance->pending) {
+      instance->pending--;
+    }
+    instance->fill();
+  }
+}
+
+/*!
+ *  @brief  Writes words until HUNTER_I2S_DEPTH buffers are ahead of the playing one.
+ *          The buffer of the last pulse is completed with silent words, the frame is done when it has been played.
+ */
+void IRAM_ATTR HUNTER_I2S_TX::fill() {
+  while (state == HUNTER_TX_STATE::TX_BUSY) {
+    if ((words % HUNTER_I2S_BUF_LEN) == 0) {
+      if (edge >= edgeCount) {
+        // all buffers of the frame are written, done when the last one has been played
+        if (pending == 0) {
+          STATS_ONLY(frameEnd = micros();)
+          state = HUNTER_TX_STATE::TX_DONE;
+        }
+        return;
+      }
+      if (pending > HUNTER_I2S_DEPTH) {
+        return;
+      }
+    }
+    if (!wordReady) {
+      word = (edge < edgeCount) ? nextWord() : 0;
+      wordReady = true;
+    }
+    if (!i2s_write_sample_nb(word)) {
+      return;
+    }
+    if ((words % HUNTER_I2S_BUF_LEN) == 0) {
+      pending++;    // the word starts a new buffer
+    }
+    words++;
+    wordReady = false;
+  }
+}
+
+/*!
+ *  @brief  Expands the next 32 ticks of the pulse train, high order bit is played first.
+ *  @return The word, bits after the last pulse are 0.
+ */
+uint32_t IRAM_ATTR HUNTER_I2S_TX::nextWord() {
+  uint32_t result = 0;
+  byte bit = 0;
+  while (bit < 32) {
+    if (ticks == 0) {
+      edge++;
+      if (edge >= edgeCount) {
+        break;
+      }
+      ticks = (hunterPulseLength(frame, dataBits, extrabit, edge) + HUNTER_I2S_TICK / 2) / HUNTER_I2S_TICK;
+      continue;
+    }
+    byte count = (ticks < (uint32_t)(32 - bit)) ? ticks : 32 - bit;
+    // even edges start a high pulse, odd edges the low pulse following it
+    if (!(edge & 0x1)) {
+      uint32_t mask = (count == 32) ? 0xffffffff : ((1UL << count) - 1);
+      result |= mask << (32 - bit - count);
+    }
+    ticks -= count;
+    bit += count;
+  }
+  return result;
+}
@@ -0,0 +1,81 @@
+/*!
+ *  @file hunter_i2s.h
+ *
+ *  This is a hardware timed transmitter for frames on the Hunter REM line using the I2S DMA.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HUNTER_I2S_H
+#define HUNTER_I2S_H
+
+#include <Arduino.h>
+#include "hunter_wave.h"
+#include "hunter_tx.h"
+
+#define HUNTER_I2S_PIN      3     // GPIO3 (RX), the only pin of the I2S data output
+#define HUNTER_I2S_TICK     4     // us per bit on the I2S data line
+#define HUNTER_I2S_RATE     (1000000UL / HUNTER_I2S_TICK / 32)  // samples/s, 32 bits per stereo sample
+#define HUNTER_I2S_BUF_LEN  64    // words per DMA buffer, SLC_BUF_LEN of the core I2S driver
+#define HUNTER_I2S_DEPTH    2     // DMA buffers written ahead of the one playing, one buffer lasts ~8 ms
+
+// rounding to the tick shifts an edge by at most HUNTER_I2S_TICK / 2, keep it within 2% of the shortest pulse
+static_assert(SHORT_INTERVAL >= 25 * HUNTER_I2S_TICK, "I2S tick too coarse for SHORT_INTERVAL");
+// the driver keeps at most SLC_BUF_CNT - 1 (7) played buffers free for writing
+static_assert((HUNTER_I2S_DEPTH >= 1) && (HUNTER_I2S_DEPTH < 7), "HUNTER_I2S_DEPTH exceeds the DMA ring");
+
+/*!
+ *  @brief  Class that plays a frame on the REM line out of the I2S DMA buffers.
+ *
+ *  It has the interface of HUNTER_TX. The pulse train is expanded into 32 bit words, each bit
+ *  lasts HUNTER_I2S_TICK us on the data line. Edges are timed by the I2S clock, interrupts of
+ *  the WIFI stack do not shift them. The I2S output is started once and plays silence between
+ *  frames. The refill callback of the driver runs once per played DMA buffer, it keeps
+ *  HUNTER_I2S_DEPTH buffers written ahead until the frame is out.
+ *  Note: the driver also outputs its clocks on GPIO15 (BCK) and GPIO2 (WS), Serial can only
+ *  transmit while the data output owns GPIO3.
+ */
+class HUNTER_I2S_TX {
+public:
+  // constructor
+  HUNTER_I2S_TX() : pin(0), started(false), state(HUNTER_TX_STATE::TX_IDLE) {};
+  // public methods
+  void    begin(const uint8_t pin);
+  boolean send(const byte* frame, const byte len, const bool extrabit);
+  boolean isBusy() const { return state == HUNTER_TX_STATE::TX_BUSY; }
+  boolean canSend() const { return !isBusy() && !(instance && instance->isBusy()); }   // the I2S output is free
+  boolean isDone() const { return state == HUNTER_TX_STATE::TX_DONE; }
+  boolean frameDone();
+#if USE_STATS
+  uint32_t getFrameDuration() const { return frameEnd - frameStart; }
+  uint32_t getMaxJitter() const { return 0; }    // edges are timed by the I2S clock
+#endif
+
+private:
+  static void     onRefill();
+  void            fill();
+  uint32_t        nextWord();
+
+  static HUNTER_I2S_TX*     instance;   // transmitter owning the I2S output
+  uint8_t                   pin;
+  boolean                   started;    // the I2S output is running
+  byte                      frame[HUNTER_MAX_FRAME];
+  uint16_t                  dataBits;   // bits taken from frame
+  bool                      extrabit;   // an extra 1 bit follows the data bits
+  uint16_t                  edgeCount;  // all edges incl. reset, start and stop pulse
+  uint16_t                  edge;       // index of the running pulse
+  uint32_t                  ticks;      // bits left of the running pulse
+  uint16_t                  words;      // words written of this frame
+  volatile byte             pending;    // buffers to be played until the last written one is out, incl. the playing one
+  uint32_t                  word;       // next word, not yet accepted by the driver
+  bool                      wordReady;
+  volatile HUNTER_TX_STATE  state;
+#if USE_STATS
+  uint32_t                  frameStart;   // micros() of send()
+  volatile uint32_t         frameEnd;     // micros() the last buffer of the frame was played
+#endif
+};
+
+#endif // HUNTER_I2S_H
@@ -0,0 +1,87 @@
+/*!
+ *  @file hunter_policy.h
+ *
+ *  These are the component policies of HUNTER_CTRL, selected at compile time.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HUNTER_POLICY_H
+#define HUNTER_POLICY_H
+
+#include <Arduino.h>
+#include "oled.h"
+#include "logger.h"
+
+#define NO_PUMP        0xff   // pump pin of a controller without a pump
+
+/*!
+ *  @brief  Display policy showing the watering state on the OLED.
+ *
+ *  The OLED must exist, an application without one selects NULL_DISPLAY.
+ */
+class OLED_DISPLAY {
+public:
+  void begin(OLED* oled) { this->oled = oled; }
+  void action(const char* message) { oled->updateAction(message); }
+  void hunterInfo(const int zone, const int time, const int program = 0) { oled->updateHunterInfo(zone, time, program); }
+
+private:
+  OLED* oled = nullptr;
+};
+
+/*!
+ *  @brief  Display policy without a display, the calls compile to nothing.
+ */
+class NULL_DISPLAY {
+public:
+  void begin(OLED*) {}
+  void action(const char*) {}
+  void hunterInfo(const int, const int, const int = 0) {}
+};
+
+/*!
+ *  @brief  Pump policy switching a relay on a GPIO, a controller with pin NO_PUMP has none.
+ */
+class PIN_PUMP {
+public:
+  /*!
+   *  @brief  Assigns the pin and sets the pump to its default.
+   *  @param  pin  GPIO of the relay or NO_PUMP.
+   *  @param  on   Default state of the pump.
+   */
+  void begin(const uint8_t pin, const boolean on) {
+    this->pin = pin;
+    if (pin != NO_PUMP) {
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, on ? HIGH : LOW);
+    }
+  }
+
+  /*!
+   *  @brief  Switches the pump on or off.
+   *  @param  on  Boolean indicating whether to turn the pump on or off.
+   */
+  void set(const boolean on) {
+    if (pin != NO_PUMP) {
+      LOG_DEBUG("Set GPIO%u %s.", pin, on ? "high" : "low");
+      digitalWrite(pin, on ? HIGH : LOW);
+    }
+  }
+
+private:
+  uint8_t pin = NO_PUMP;
+};
+
+/*!
+ *  @brief  Pump policy without a pump, the calls compile to nothing.
+ */
+class NULL_PUMP {
+public:
+  void begin(const uint8_t, const boolean) {}
+  void set(const boolean) {}
+};
+
+#endif // HUNTER_POLICY_H
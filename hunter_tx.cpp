@@ -0,0 +1,129 @@
+/*!
+ *  @file hunter_tx.cpp
+ *
+ *  @mainpage  non-blocking transmitter for the HUNTER XCORE REM line.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  This class sends a frame on the REM line without blocking the main loop.
+ *  The frame is sent as a sequence of edges, the length of each pulse is timed by timer1
+ *  in single shot mode, its ISR drives the next edge and rearms the timer.
+ *  The pulse train of a frame is defined in hunter_wave.h.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "hunter_tx.h"
+#include "logger.h"
+
+// definitions to adjust signaling on the HUNTER control line
+#define HUNTER_ONE HIGH         // This makes inverting the signal easy
+#define HUNTER_ZERO LOW
+
+HUNTER_TX* HUNTER_TX::instance = nullptr;
+
+/*!
+ *  @brief  Assigns the REM pin and sets the bus to idle.
+ *  @param  pin  GPIO connected to the REM line of the X-Core
+ */
+void HUNTER_TX::begin(const uint8_t pin) {
+  this->pin = pin;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, HUNTER_ZERO);
+  state = HUNTER_TX_STATE::TX_IDLE;
+}
+
+/*!
+ *  @brief  Starts the transmission of a frame, returns right away.
+ *  @param  frame     The bytes to send, high order bit first.
+ *  @param  len       Number of bytes in frame, at most HUNTER_MAX_FRAME.
+ *  @param  extrabit  If true, an extra 1 bit is sent after the frame.
+ *  @return True if the frame was accepted, false if a frame is still going out or it is too long.
+ */
+boolean HUNTER_TX::send(const byte* frame, const byte len, const bool extrabit) {
+  if (isBusy() || (instance && instance->isBusy())) {
+    return false;
+  }
+  if (len > HUNTER_MAX_FRAME) {
+    LOG_ERROR("frame too long");
+    return false;
+  }
+  memcpy(this->frame, frame, len);
+  this->dataBits = len * 8;
+  this->extrabit = extrabit;
+  this->edgeCount = hunterEdgeCount(dataBits, extrabit);
+  this->edge = 0;
+  this->state = HUNTER_TX_STATE::TX_BUSY;
+  STATS_ONLY(frameStart = edgeDue = micros(); maxLate = 0;)
+
+  instance = this;
+  timer1_attachInterrupt(HUNTER_TX::onTimer);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+  step();  // drive first edge, the ISR takes over
+  return true;
+}
+
+/*!
+ *  @brief  Reports a completed frame once.
+ *  @return True if a frame has completed since the last call.
+ */
+boolean HUNTER_TX::frameDone() {
+  if (state == HUNTER_TX_STATE::TX_DONE) {
+    state = HUNTER_TX_STATE::TX_IDLE;
+    return true;
+  }
+  return false;
+}
+
+// ======= private functions ===================================================
+
+/*!
+ *  @brief  timer1 ISR, forwards to the transmitter owning the timer.
+ */
+void IRAM_ATTR HUNTER_TX::onTimer() {
+  if (instance) {
+    instance->step();
+  }
+}
+
+/*!
+ *  @brief  Drives the next edge and arms timer1 for its duration.
+ *          After the last pulse the line is released and the timer stopped.
+ */
+void IRAM_ATTR HUNTER_TX::step() {
+  uint16_t current = edge;
+#if USE_STATS
+  uint32_t now = micros();
+  if ((int32_t)(now - edgeDue) > (int32_t)maxLate) {
+    maxLate = now - edgeDue;
+  }
+#endif
+  if (current >= edgeCount) {
+    digitalWrite(pin, HUNTER_ZERO);
+    timer1_disable();
+    STATS_ONLY(frameEnd = now;)
+    state = HUNTER_TX_STATE::TX_DONE;
+    return;
+  }
+  // even edges start a high pulse, odd edges the low pulse following it
+  digitalWrite(pin, (current & 0x1) ? HUNTER_ZERO : HUNTER_ONE);
+  uint32_t length = pulseLength(current);
+  timer1_write(length * TICKS_PER_US);
+  STATS_ONLY(edgeDue = now + length;)
+  edge = current + 1;
+}
+
+/*!
+ *  @brief  Gets the length of the pulse started by an edge.
+ *  @param  edge  index of the edge
+ *  @return The pulse length in us.
+ */
+uint32_t IRAM_ATTR HUNTER_TX::pulseLength(const uint16_t edge) const {
+  return hunterPulseLength(frame, dataBits, extrabit, edge);
+}
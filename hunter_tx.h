@@ -0,0 +1,74 @@
+/*!
+ *  @file hunter_tx.h
+ *
+ *  This is a non-blocking transmitter for frames on the Hunter REM line.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HUNTER_TX_H
+#define HUNTER_TX_H
+
+#include <Arduino.h>
+#include "hunter_wave.h"
+#include "stats.h"
+
+#define HUNTER_MAX_FRAME  15     // longest frame (zone frame) in bytes
+
+/*!
+ *  @brief  States of the transmitter state machine.
+ */
+enum class HUNTER_TX_STATE : byte {
+  TX_IDLE   = 0,    // nothing sent yet or done flag consumed
+  TX_BUSY   = 1,    // frame is going out on the bus
+  TX_DONE   = 2,    // frame completed, not yet acknowledged by frameDone()
+};
+
+/*!
+ *  @brief  Class that sends a frame on the REM line driven by the timer1 interrupt.
+ *
+ *  send() copies the frame, drives the first edge and returns right away.
+ *  Every following edge is set in the timer1 ISR, which arms the timer for the
+ *  duration of the next pulse. Only one transmitter can own timer1 at a time.
+ *  Note: timer1 is shared with the ESP8266 waveform generator (analogWrite, tone, Servo)
+ */
+class HUNTER_TX {
+public:
+  // constructor
+  HUNTER_TX() : pin(0), state(HUNTER_TX_STATE::TX_IDLE) {};
+  // public methods
+  void    begin(const uint8_t pin);
+  boolean send(const byte* frame, const byte len, const bool extrabit);
+  boolean isBusy() const { return state == HUNTER_TX_STATE::TX_BUSY; }
+  boolean canSend() const { return !isBusy() && !(instance && instance->isBusy()); }   // timer1 is free
+  boolean isDone() const { return state == HUNTER_TX_STATE::TX_DONE; }
+  boolean frameDone();
+#if USE_STATS
+  uint32_t getFrameDuration() const { return frameEnd - frameStart; }
+  uint32_t getMaxJitter() const { return maxLate; }
+#endif
+
+private:
+  static void     onTimer();
+  void            step();
+  uint32_t        pulseLength(const uint16_t edge) const;
+
+  static HUNTER_TX*         instance;   // transmitter owning timer1
+  uint8_t                   pin;
+  byte                      frame[HUNTER_MAX_FRAME];
+  uint16_t                  dataBits;   // bits taken from frame
+  bool                      extrabit;   // an extra 1 bit follows the data bits
+  uint16_t                  edgeCount;  // all edges incl. reset, start and stop pulse
+  volatile uint16_t         edge;       // index of the next edge to drive
+  volatile HUNTER_TX_STATE  state;
+#if USE_STATS
+  uint32_t                  frameStart;   // micros() of send()
+  volatile uint32_t         frameEnd;     // micros() of the last edge
+  volatile uint32_t         edgeDue;      // micros() the running pulse shall end
+  volatile uint32_t         maxLate;      // us, max lateness of an edge in this frame
+#endif
+};
+
+#endif // HUNTER_TX_H
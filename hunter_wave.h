@@ -0,0 +1,90 @@
+/*!
+ *  @file hunter_wave.h
+ *
+ *  This is the compile-time model of the pulse train on the Hunter REM line.
+ *
+ *  The timer1 ISR of HUNTER_TX and the static_assert checks of the encoder use the same
+ *  constexpr functions, so the waveform is verified by the compiler with every build.
+ *  A frame consists of
+ *    - reset pulse  RESET_INTERVAL ms high, RESET_PAUSE ms low
+ *    - start pulse  START_INTERVAL us high, SHORT_INTERVAL us low
+ *    - data bits    1: LONG_INTERVAL high / SHORT_INTERVAL low, 0: SHORT_INTERVAL high / LONG_INTERVAL low
+ *    - an optional extra 1 bit and a 0 bit as stop pulse
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef HUNTER_WAVE_H
+#define HUNTER_WAVE_H
+
+#include <Arduino.h>
+
+// definitions to adjust signaling on the HUNTER control line
+#define RESET_INTERVAL 325      // ms
+#define RESET_PAUSE 65          // ms
+#define START_INTERVAL 900      // us
+#define SHORT_INTERVAL 208      // us
+#define LONG_INTERVAL 1875      // us
+
+#define EDGES_BEFORE_DATA 4     // reset high/low and start high/low
+#define TICKS_PER_US  5         // timer1 runs with 80MHz / TIM_DIV16
+#define TIMER1_MAX_TICKS 0x7fffff  // timer1 counter is 23 bit
+
+// the ISR arms timer1 once per pulse, every pulse has to fit into the counter
+static_assert((RESET_INTERVAL * 1000UL * TICKS_PER_US <= TIMER1_MAX_TICKS)
+           && (RESET_PAUSE * 1000UL * TICKS_PER_US <= TIMER1_MAX_TICKS), "reset pulse exceeds timer1");
+// a receiver tells the pulses apart by their length only
+static_assert((SHORT_INTERVAL < START_INTERVAL) && (START_INTERVAL < LONG_INTERVAL), "pulse lengths not distinct");
+
+/*!
+ *  @brief  Gets the number of edges of a frame.
+ *  @param  dataBits  bits taken from the frame
+ *  @param  extrabit  an extra 1 bit follows the data bits
+ *  @return All edges incl. reset, start and stop pulse, every bit is a high and a low pulse.
+ */
+constexpr uint16_t hunterEdgeCount(const uint16_t dataBits, const bool extrabit) {
+  return EDGES_BEFORE_DATA + 2 * (dataBits + (extrabit ? 1 : 0) + 1);
+}
+
+/*!
+ *  @brief  Gets a bit of the data part, incl. extra bit and stop bit.
+ *  @param  frame     the bytes to send, high order bit first
+ *  @param  dataBits  bits taken from frame
+ *  @param  extrabit  an extra 1 bit follows the data bits
+ *  @param  pos       bit position, 0 is the high order bit of the first byte
+ *  @return The bit value.
+ */
+__attribute__((always_inline)) constexpr bool hunterBitAt(const byte* frame, const uint16_t dataBits,
+                                                          const bool extrabit, const uint16_t pos) {
+  if (pos < dataBits) {
+    return frame[pos / 8] & (0x80 >> (pos % 8));
+  }
+  // extra bit is 1, stop bit is always 0
+  return extrabit && (pos == dataBits);
+}
+
+/*!
+ *  @brief  Gets the length of the pulse started by an edge, even edges start a high pulse.
+ *  @param  frame     the bytes to send, high order bit first
+ *  @param  dataBits  bits taken from frame
+ *  @param  extrabit  an extra 1 bit follows the data bits
+ *  @param  edge      index of the edge
+ *  @return The pulse length in us.
+ */
+__attribute__((always_inline)) constexpr uint32_t hunterPulseLength(const byte* frame, const uint16_t dataBits,
+                                                                    const bool extrabit, const uint16_t edge) {
+  switch (edge) {
+    case 0: return RESET_INTERVAL * 1000UL;  // Resetimpulse
+    case 1: return RESET_PAUSE * 1000UL;
+    case 2: return START_INTERVAL;           // Startimpulse
+    case 3: return SHORT_INTERVAL;
+  }
+  bool high = !((edge - EDGES_BEFORE_DATA) & 0x1);
+  bool bit = hunterBitAt(frame, dataBits, extrabit, (edge - EDGES_BEFORE_DATA) / 2);
+  // a 1 is a long high pulse, a 0 a short one
+  return (high == bit) ? LONG_INTERVAL : SHORT_INTERVAL;
+}
+
+#endif // HUNTER_WAVE_H
@@ -0,0 +1,127 @@
+/*!
+ *  @file json_arena.h
+ *
+ *  This is a statically reserved memory pool for ArduinoJson documents.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define JSON_ARENA_ALIGN  8   // alignment of every block, same as malloc()
+
+/*!
+ *  @brief  Template class for an ArduinoJson allocator working on SIZE bytes of static memory.
+ *
+ *  Blocks are taken from the pool one after the other, each with a small header holding its size.
+ *  Freeing the last block gives its memory back, when all blocks are freed the pool is empty again.
+ *  Hand it to a document with JsonDocument doc(&arena), the pool is reset when the document is gone.
+ *  Allocation is constant time and never touches the heap, a full pool makes ArduinoJson report NoMemory.
+ */
+template <size_t SIZE>
+class JSON_ARENA : public ArduinoJson::Allocator {
+  static_assert(SIZE % JSON_ARENA_ALIGN == 0, "JSON_ARENA size has to be a multiple of JSON_ARENA_ALIGN");
+
+public:
+  // constructor
+  JSON_ARENA() : offset(0), blocks(0), peak(0) {};
+
+  /*!
+   *  @brief  Takes a block from the pool.
+   *  @param  size  Size of the block in bytes.
+   *  @return Pointer to the block or nullptr if the pool is exhausted.
+   */
+  void* allocate(size_t size) override {
+    size_t needed = HEADER + align(size);
+    if (needed > SIZE - offset) {
+      return nullptr;
+    }
+    uint8_t* block = pool + offset;
+    *(size_t*)block = size;
+    offset += needed;
+    blocks++;
+    if (offset > peak) {
+      peak = offset;
+    }
+    return block + HEADER;
+  }
+
+  /*!
+   *  @brief  Gives a block back, only the memory of the last block or of an empty pool is reused.
+   *  @param  ptr  Pointer returned by allocate() or reallocate().
+   */
+  void deallocate(void* ptr) override {
+    if (ptr == nullptr) {
+      return;
+    }
+    uint8_t* block = (uint8_t*)ptr - HEADER;
+    if (block + HEADER + align(*(size_t*)block) == pool + offset) {
+      offset = block - pool;
+    }
+    if (--blocks == 0) {
+      offset = 0;
+    }
+  }
+
+  /*!
+   *  @brief  Resizes a block, the last block grows in place, any other block is copied.
+   *  @param  ptr       Pointer returned by allocate() or reallocate().
+   *  @param  new_size  New size of the block in bytes.
+   *  @return Pointer to the resized block or nullptr if the pool is exhausted.
+   */
+  void* reallocate(void* ptr, size_t new_size) override {
+    if (ptr == nullptr) {
+      return allocate(new_size);
+    }
+    uint8_t* block = (uint8_t*)ptr - HEADER;
+    size_t oldSize = *(size_t*)block;
+    if (block + HEADER + align(oldSize) == pool + offset) {
+      // last block, resize in place
+      size_t start = block - pool;
+      if (HEADER + align(new_size) > SIZE - start) {
+        return nullptr;
+      }
+      *(size_t*)block = new_size;
+      offset = start + HEADER + align(new_size);
+      if (offset > peak) {
+        peak = offset;
+      }
+      return ptr;
+    }
+    void* newPtr = allocate(new_size);
+    if (newPtr) {
+      memcpy(newPtr, ptr, (oldSize < new_size) ? oldSize : new_size);
+      deallocate(ptr);
+    }
+    return newPtr;
+  }
+
+  /*!
+   *  @brief  Empties the pool, any document still using it must be gone.
+   */
+  void reset() {
+    offset = 0;
+    blocks = 0;
+  }
+
+  size_t used() const     { return offset; }
+  size_t peakUsed() const { return peak; }
+  size_t capacity() const { return SIZE; }
+
+private:
+  static constexpr size_t HEADER = JSON_ARENA_ALIGN;
+  static constexpr size_t align(size_t size) { return (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1); }
+
+  alignas(JSON_ARENA_ALIGN) uint8_t pool[SIZE];
+  size_t    offset;   // first free byte
+  uint16_t  blocks;   // blocks not given back
+  size_t    peak;     // highest offset since start, to tune SIZE
+};
+
+#endif // JSON_ARENA_H
@@ -0,0 +1,294 @@
+/*!
+ *  @file json_writer.cpp
+ *
+ *  @mainpage  fixed buffer JSON serializer.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  This class serializes the small documents published to the MQTT broker.
+ *  The shape of each document is known in advance, so it is written straight into a
+ *  buffer without building a document tree first and without any dynamic memory.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "json_writer.h"
+
+/*!
+ * @brief constructor, starts with an empty output
+ *
+ * @param buffer  buffer receiving the zero terminated output
+ * @param size    size of buffer in bytes
+ */
+JSON_WRITER::JSON_WRITER(char* buffer, const size_t size) :
+  buffer(buffer), size(size), len(0), overflow(size == 0), depth(0), filled(0), arrays(0) {
+  if (size) {
+    buffer[0] = '\0';
+  }
+}
+
+/*!
+ * @brief opens an object
+ *
+ * @param key  member name in the enclosing object, nullptr for the top level object
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::beginObject(const char* key) {
+  if (open(key, '{')) {
+    arrays &= ~(1 << depth);
+  }
+  return *this;
+}
+
+/*!
+ * @brief closes the innermost open object
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::endObject() {
+  close('}');
+  return *this;
+}
+
+/*!
+ * @brief opens an array, its elements are added with value() and null()
+ *
+ * @param key  member name in the enclosing object
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::beginArray(const char* key) {
+  if (open(key, '[')) {
+    arrays |= (1 << depth);
+  }
+  return *this;
+}
+
+/*!
+ * @brief closes the innermost open array
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::endArray() {
+  close(']');
+  return *this;
+}
+
+/*!
+ * @brief adds an integer element to the open array
+ *
+ * @param value  value
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::value(const int value) {
+  return add(nullptr, value);
+}
+
+/*!
+ * @brief adds a null element to the open array
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::null() {
+  key(nullptr);
+  raw("null");
+  return *this;
+}
+
+/*!
+ * @brief adds a string member, quotes and control characters are escaped
+ *
+ * @param key    member name
+ * @param value  zero terminated string, nullptr is written as null
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::add(const char* key, const char* value) {
+  this->key(key);
+  if (value) {
+    string(value);
+  } else {
+    raw("null");
+  }
+  return *this;
+}
+
+/*!
+ * @brief adds an integer member
+ *
+ * @param key    member name
+ * @param value  value
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::add(const char* key, const int value) {
+  char text[12];
+  this->key(key);
+  ltoa(value, text, 10);
+  raw(text);
+  return *this;
+}
+
+/*!
+ * @brief adds an unsigned 32 bit member, e.g. a counter or time stamp beyond the range of int
+ *
+ * @param key    member name
+ * @param value  value
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::add(const char* key, const uint32_t value) {
+  char text[11];
+  this->key(key);
+  ultoa(value, text, 10);
+  raw(text);
+  return *this;
+}
+
+/*!
+ * @brief adds a float member with a fixed number of decimals
+ *
+ * @param key       member name
+ * @param value     value, NaN and infinity are written as null
+ * @param decimals  digits after the decimal point
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::add(const char* key, const float value, const byte decimals) {
+  char text[20];
+  this->key(key);
+  if (isnan(value) || isinf(value) || (fabs(value) > 1e9)) {
+    raw("null");
+  } else {
+    dtostrf(value, 1, decimals, text);
+    raw(text);
+  }
+  return *this;
+}
+
+/*!
+ * @brief adds a boolean member
+ *
+ * @param key    member name
+ * @param value  value
+ *
+ * @return this writer to chain calls
+ */
+JSON_WRITER& JSON_WRITER::add(const char* key, const boolean value) {
+  this->key(key);
+  raw(value ? "true" : "false");
+  return *this;
+}
+
+// ======= private functions ===================================================
+
+/*!
+ * @brief writes the separator and the name of a member, array elements have no name
+ *
+ * @param key  member name
+ */
+void JSON_WRITER::key(const char* key) {
+  if (filled & (1 << depth)) {
+    put(',');
+  }
+  filled |= (1 << depth);
+  if ((depth > 0) && !(arrays & (1 << depth)) && key) {
+    string(key);
+    put(':');
+  }
+}
+
+/*!
+ * @brief opens an object or array
+ *
+ * @param key      member name in the enclosing object, nullptr for the top level or an array element
+ * @param bracket  opening bracket
+ *
+ * @return true if opened, false if nested too deep
+ */
+boolean JSON_WRITER::open(const char* key, const char bracket) {
+  if (depth >= JSON_WRITER_DEPTH) {
+    overflow = true;
+    return false;
+  }
+  if (key || (depth > 0)) {
+    this->key(key);
+  }
+  put(bracket);
+  depth++;
+  filled &= ~(1 << depth);
+  return true;
+}
+
+/*!
+ * @brief closes the innermost open object or array
+ *
+ * @param bracket  closing bracket
+ *
+ * @return true if closed, false if nothing is open
+ */
+boolean JSON_WRITER::close(const char bracket) {
+  if (depth == 0) {
+    overflow = true;
+    return false;
+  }
+  put(bracket);
+  depth--;
+  return true;
+}
+
+/*!
+ * @brief writes a quoted and escaped string
+ *
+ * @param value  zero terminated string
+ */
+void JSON_WRITER::string(const char* value) {
+  put('"');
+  for (; *value; value++) {
+    char c = *value;
+    if ((c == '"') || (c == '\\')) {
+      put('\\');
+      put(c);
+    } else if ((uint8_t)c < 0x20) {
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", (uint8_t)c);
+      raw(esc);
+    } else {
+      put(c);
+    }
+  }
+  put('"');
+}
+
+/*!
+ * @brief writes text as it is
+ *
+ * @param text  zero terminated text
+ */
+void JSON_WRITER::raw(const char* text) {
+  while (*text) {
+    put(*text++);
+  }
+}
+
+/*!
+ * @brief appends a character, keeps the output zero terminated
+ *
+ * @param c  character to append
+ */
+void JSON_WRITER::put(const char c) {
+  if (len + 1 >= size) {
+    overflow = true;
+    return;
+  }
+  buffer[len++] = c;
+  buffer[len] = '\0';
+}
@@ -0,0 +1,61 @@
+/*!
+ *  @file json_writer.h
+ *
+ *  This is a small JSON serializer writing into a fixed buffer.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+
+#define JSON_WRITER_DEPTH   8     // max nesting of objects
+
+/*!
+ *  @brief  Class writing a JSON document of known shape into a caller provided buffer.
+ *
+ *  Objects are opened and closed explicitly, values are appended as they come, nothing
+ *  is stored but the text itself. An output not fitting into the buffer is flagged as
+ *  overflowed and must not be used.
+ */
+class JSON_WRITER {
+public:
+  // constructor
+  JSON_WRITER(char* buffer, const size_t size);
+  // public methods
+  JSON_WRITER& beginObject(const char* key = nullptr);
+  JSON_WRITER& endObject();
+  JSON_WRITER& beginArray(const char* key);
+  JSON_WRITER& endArray();
+  JSON_WRITER& value(const int value);
+  JSON_WRITER& null();
+  JSON_WRITER& add(const char* key, const char* value);
+  JSON_WRITER& add(const char* key, const int value);
+  JSON_WRITER& add(const char* key, const uint32_t value);
+  JSON_WRITER& add(const char* key, const float value, const byte decimals);
+  JSON_WRITER& add(const char* key, const boolean value);
+  const char*  c_str() const      { return buffer; }
+  size_t       length() const     { return len; }
+  boolean      overflowed() const { return overflow; }
+
+private:
+  void    key(const char* key);
+  boolean open(const char* key, const char bracket);
+  boolean close(const char bracket);
+  void    string(const char* value);
+  void    raw(const char* text);
+  void    put(const char c);
+  char*   buffer;
+  size_t  size;
+  size_t  len;
+  boolean overflow;
+  byte    depth;
+  uint16_t filled;  // bit per nesting level, set once the object has a member
+  uint16_t arrays;  // bit per nesting level, set for an array
+};
+
+#endif // JSON_WRITER_H
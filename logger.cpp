@@ -0,0 +1,133 @@
+/*!
+ *  @file logger.cpp
+ *
+ *  @mainpage  leveled logger with a RAM ring buffer.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  Serial.print() blocks as soon as the 128 byte FIFO of the UART is full, at 74880 baud a
+ *  few lines stall the caller for milliseconds. Messages are formatted into a ring instead
+ *  and written by a scheduler task in idle time
+ *    <millis> <level> <message>
+ *  e.g. "12345 W hunter command queue full". LOG_LEVEL selects at compile time which of
+ *  LOG_ERROR, LOG_WARN, LOG_INFO and LOG_DEBUG are built at all.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "logger.h"
+#include <stdarg.h>
+
+LOGGER appLog;
+
+// level letters, index is the level
+static const char LEVEL_NAMES[] = "-EWID";
+
+/*!
+ * @brief formats a message into the ring, it is dropped if the ring is full
+ *
+ * @param level  LOG_LEVEL_ERROR ... LOG_LEVEL_DEBUG
+ * @param fmt    printf format, the line end is added
+ */
+void LOGGER::write(const byte level, const char* fmt, ...) {
+  char line[LOG_LINE];
+  int prefix = snprintf(line, sizeof(line), "%lu %c ", (unsigned long)millis(), LEVEL_NAMES[level & 0x07]);
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line + prefix, sizeof(line) - prefix, fmt, args);
+  va_end(args);
+
+  size_t length = strlen(line);
+  if ((size_t)(serialRing.capacity() - serialRing.size()) < length + 2) {
+    dropped++;
+  } else {
+    for (size_t i = 0; i < length; i++) {
+      serialRing.push(line[i]);
+    }
+    serialRing.push('\r');
+    serialRing.push('\n');
+  }
+
+  if (mirror && !mirroring && (level <= LOG_MIRROR_LEVEL)) {
+    LOG_TEXT text;
+    memcpy(text.text, line, length + 1);
+    if (!mirrorRing.push(text)) {
+      mirrorDropped++;
+    }
+  }
+}
+
+/*!
+ * @brief loop called periodically, hands the ring to Serial and the mirror, never blocks
+ *
+ * lost messages are reported on Serial only, a report queued for a mirror that is down would be lost
+ * again and report itself with every loop
+ */
+void LOGGER::loop() {
+  if (((dropped != reportedDrops) || (mirrorDropped != reportedMirrorDrops))
+      && (serialRing.size() < serialRing.capacity() / 2)) {
+    reportedDrops = dropped;
+    reportedMirrorDrops = mirrorDropped;
+    mirroring = true;
+    LOG_WARN("log overflow, %lu serial and %lu mirrored messages dropped since start",
+             (unsigned long)dropped, (unsigned long)mirrorDropped);
+    mirroring = false;
+  }
+  drainSerial();
+  drainMirror();
+}
+
+/*!
+ * @brief writes all pending messages and waits for the UART, only for fatal paths
+ */
+void LOGGER::flush() {
+  char c;
+  while (serialRing.pop(c)) {
+    Serial.write((uint8_t)c);
+  }
+  Serial.flush();
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief writes as much of the ring as the UART FIFO takes without waiting
+ */
+void LOGGER::drainSerial() {
+  char chunk[LOG_CHUNK];
+  int room = Serial.availableForWrite();
+  while ((room > 0) && !serialRing.empty()) {
+    size_t count = 0;
+    while ((count < sizeof(chunk)) && (count < (size_t)room) && serialRing.pop(chunk[count])) {
+      count++;
+    }
+    Serial.write((const uint8_t*)chunk, count);
+    room -= count;
+  }
+}
+
+/*!
+ * @brief hands the queued messages to the mirror, the oldest is kept until it is taken
+ */
+void LOGGER::drainMirror() {
+  if (!mirror) {
+    return;
+  }
+  const LOG_TEXT* text;
+  while ((text = mirrorRing.peek()) != nullptr) {
+    mirroring = true;
+    boolean taken = mirror(text->text);
+    mirroring = false;
+    if (!taken) {
+      return;
+    }
+    LOG_TEXT done;
+    mirrorRing.pop(done);
+  }
+}
@@ -0,0 +1,102 @@
+/*!
+ *  @file logger.h
+ *
+ *  This is a leveled logger writing into a RAM ring, drained to Serial in idle time.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+
+#define LOG_LEVEL_NONE    0
+#define LOG_LEVEL_ERROR   1
+#define LOG_LEVEL_WARN    2
+#define LOG_LEVEL_INFO    3
+#define LOG_LEVEL_DEBUG   4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL         LOG_LEVEL_INFO    // messages of a higher level are compiled out
+#endif
+#define LOG_MIRROR_LEVEL  LOG_LEVEL_WARN    // messages up to this level are mirrored to PRE_MQTT/log
+#define LOG_BUFFER        1024              // bytes of the serial ring, power of 2
+#define LOG_LINE          96                // max length of one message incl. prefix
+#define LOG_MIRROR_LINES  8                 // mirrored messages waiting for the broker, power of 2
+#define LOG_CHUNK         32                // bytes handed to Serial at once
+
+/*!
+ *  @brief  Function publishing a mirrored message, returns false if it shall be tried again later.
+ */
+typedef boolean (*LOG_SINK)(const char* line);
+
+/*!
+ *  @brief  Struct for a message waiting for the mirror.
+ */
+typedef struct {
+  char text[LOG_LINE];
+} LOG_TEXT;
+
+/*!
+ *  @brief  Class that formats messages into a ring buffer, so logging never waits for the UART.
+ *
+ *  write() only formats into the ring, loop() hands to Serial what fits into its FIFO without
+ *  blocking. A message not fitting into the ring is dropped and counted. Messages up to
+ *  LOG_MIRROR_LEVEL are also queued for the mirror, usually the MQTT client. The mirror keeps
+ *  its own drop count, a broker outage does not show up as a full serial ring.
+ */
+class LOGGER {
+public:
+  // constructor
+  LOGGER() : mirror(nullptr), mirroring(false), dropped(0), reportedDrops(0), mirrorDropped(0), reportedMirrorDrops(0) {};
+  // public methods
+  void    write(const byte level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+  void    setMirror(LOG_SINK mirror) { this->mirror = mirror; }
+  void    loop();
+  void    flush();
+  boolean pending() const { return !serialRing.empty(); }
+  uint32_t getDropped() const { return dropped; }
+  uint32_t getMirrorDropped() const { return mirrorDropped; }
+
+private:
+  void    drainSerial();
+  void    drainMirror();
+  RING_BUFFER<char, LOG_BUFFER>             serialRing;
+  RING_BUFFER<LOG_TEXT, LOG_MIRROR_LINES>   mirrorRing;
+  LOG_SINK  mirror;
+  boolean   mirroring;      // messages written by the mirror itself are not mirrored again
+  uint32_t  dropped;        // messages lost by the serial ring since start
+  uint32_t  reportedDrops;
+  uint32_t  mirrorDropped;  // messages lost by the mirror since start, e.g. while the broker is down
+  uint32_t  reportedMirrorDrops;
+};
+
+extern LOGGER appLog;
+
+// one macro per level, messages above LOG_LEVEL expand to nothing incl. their arguments
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)  appLog.write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)  do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...)   appLog.write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...)   do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...)   appLog.write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...)   do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)  appLog.write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)  do {} while (0)
+#endif
+
+#endif // LOGGER_H
@@ -22,6 +22,9 @@
  #include "MQTT.h"
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include "hunter_frame.h"
+#include "fixed_string.h"
+#include "logger.h"
 
 // MQTT broker credentials (set to NULL if not required)
 const char* MQTT_username = "REPLACE_WITH_MQTT_USERNAME"; 
@@ -32,6 +35,31 @@ WiFiClient hunterClient;
 PubSubClient mqttClient(hunterClient);
 
 APP_DATA* pAppDataClass;    // pointer to APP_DATA class needed in subscription callback
+static MQTT* pMqttClass;    // pointer to MQTT class routing the topics in the subscription callback
+
+// memory of the document parsing a config message, the heap is not touched per message
+static JSON_ARENA<MQTT_CONFIG_ARENA> configArena;
+
+// QoS 1 messages already handled, packet ID 0 is never used by a broker
+typedef struct {
+  uint16_t  packetId;
+  uint32_t  hash;       // FNV-1a of the payload
+} MQTT_RECEIVED;
+static MQTT_RECEIVED received[MQTT_DEDUPE_SIZE] = {};
+static byte receivedNext = 0;
+
+// sequence number of the last binary command of each source, older records are dropped
+static uint16_t lastCmdSeq[(byte)CMD_SOURCE::SRC_COUNT] = {};
+static boolean  cmdSeqValid[(byte)CMD_SOURCE::SRC_COUNT] = {};
+// same for the optional sequence number of the "water" commands
+static uint16_t lastWaterSeq[(byte)CMD_SOURCE::SRC_COUNT] = {};
+static boolean  waterSeqValid[(byte)CMD_SOURCE::SRC_COUNT] = {};
+
+static boolean isRedelivery(const char* topic, const byte* message, unsigned int length);
+static void clearReceived();
+
+// topic names below PRE_MQTT, in order of MQTT_TOPIC
+static const char* const TOPIC_NAMES[(byte)MQTT_TOPIC::COUNT] = { "value", "config", "history", "stats", "log", "cmd" };
 
 /*!
  * @brief initalizes the MQTT class 
@@ -43,359 +71,784 @@ APP_DATA* pAppDataClass;    // pointer to APP_DATA class needed in subscription
     this->oled = oled;
     this->appData = appData;
     pAppDataClass = appData;
+    pMqttClass = this;
+    buildTopics();
 }
 
 /*!
  * @brief callback for receive of subscibed topics
  * 
  * This function is executed when some device publishes a message to a topic that your ESP8266 is subscribed to
- * Change the function below to add logic to your program, so when a device publishes a message to a topic that 
- * your ESP8266 is subscribed you can actually do something
+ * The topic is routed by route(), the message is parsed right from the receive buffer of the client,
+ * nothing is copied and no heap is used
  *
  * @param topic  received topic which triggered this callback
- * @param message   received message
+ * @param message   received message, not zero terminated
  * @param length  lebgth of received message
  */
-void mqttSubscriptionCallback(String topic, byte* message, unsigned int length) {
-  Serial.print("Message arrived on topic: ");
-  Serial.print(topic);
-  Serial.print(". Message: ");
-  
-  String messageTemp;
-  for (int i = 0; i < length; i++) {
-    Serial.print((char)message[i]);
-    messageTemp += (char)message[i];
-  }
-  Serial.println();
-
-  JsonDocument doc;
-  // If a message is received on the topic room/lamp, you check if the message is either on or off. Turns the lamp GPIO according to the message
-  if(topic=="hunter/config"){
-    DeserializationError error = deserializeJson(doc, messageTemp);
-    if (error) {
-      Serial.print("deserializeJson() returned ");
-      Serial.println(error.c_str());
-      return;
+void mqttSubscriptionCallback(char* topic, byte* message, unsigned int length) {
+  LOG_DEBUG("Message arrived on topic: %s, length: %u", topic, length);
+  if (isRedelivery(topic, message, length)) {
+    LOG_INFO("redelivered message, ignored");
+    return;
+  }
+
+  const MQTT_SUBSCRIPTION* sub = pMqttClass ? pMqttClass->route(topic) : nullptr;
+  switch (sub ? sub->handler : MQTT_TOPIC::COUNT) {
+    case MQTT_TOPIC::CONFIG:
+      handleConfigMessage(message, length, sub->group ? CMD_SOURCE::SRC_GROUP : CMD_SOURCE::SRC_DEVICE);
+      break;
+    case MQTT_TOPIC::CMD:
+      handleCmdMessage(message, length, sub->group ? CMD_SOURCE::SRC_GROUP : CMD_SOURCE::SRC_DEVICE);
+      break;
+    default:
+      LOG_WARN("unknown topic, ignored");
+      break;
+  }
+}
+
+/*!
+ * @brief checks if a QoS 1 message has been handled before
+ *
+ * A broker sends a QoS 1 message again with the same packet ID and the DUP flag if its PUBACK got lost,
+ * e.g. by a reconnect of the persistent session. PubSubClient does not pass packet ID and flags to the
+ * callback, but topic and message point into its receive buffer:
+ *   fixed header | remaining length (1..4 bytes) | topic length high | topic, 0 | packet ID (QoS 1 and 2 only) | message
+ * Only a message with the DUP flag can be a redelivery, it is one if packet ID and payload match one of
+ * the last MQTT_DEDUPE_SIZE messages. A message without the flag is new even if it repeats an earlier
+ * one, the broker reuses packet IDs, so it replaces the entries of its packet ID.
+ *
+ * @param topic    received topic, zero terminated in the receive buffer
+ * @param message  received message
+ * @param length   length of message
+ *
+ * @return true if the message shall be dropped
+ */
+static boolean isRedelivery(const char* topic, const byte* message, unsigned int length) {
+  if ((const char*)message - topic != (ptrdiff_t)(strlen(topic) + 3)) {
+    return false;   // QoS 0, no packet ID
+  }
+  // the fixed header sits in front of the remaining length, which counts topic length, topic, packet ID and message
+  size_t topicLength = strlen(topic);
+  uint32_t remaining = 2 + topicLength + 2 + length;
+  byte lengthBytes = (remaining < 128UL) ? 1 : (remaining < 16384UL) ? 2 : (remaining < 2097152UL) ? 3 : 4;
+  boolean dup = ((const byte*)topic)[-(lengthBytes + 2)] & MQTT_HEADER_DUP;
+
+  uint16_t packetId = (message[-2] << 8) | message[-1];
+  uint32_t hash = 2166136261UL;
+  for (unsigned int i = 0; i < length; i++) {
+    hash = (hash ^ message[i]) * 16777619UL;
+  }
+  for (byte i = 0; i < MQTT_DEDUPE_SIZE; i++) {
+    if (received[i].packetId != packetId) {
+      continue;
     }
-    // Extract the values 
-    // "wifi" array with ssid & pw
-    // "mqtt" array with ip & port
-    // "dht" array with t_offset(-3..3) & t_hold(-3.0..3.0) & h_hold(-10..10)
-    // "water" array with zone(int 1..8) & time(int 0..240 ) or  program (1..)
-    if (doc.containsKey("wifi") ) {
-      // handle wifi settings
-      Serial.println("wifi detected");
-      const char* ssid = doc["wifi"]["ssid"]; // "10.11.12.13"
-      const char* pw = doc["wifi"]["pw"]; // "10.11.12.13"
-      if (ssid != NULL) {
-        // update data and trigger new connect via flag
-        if (pAppDataClass) {
-          pAppDataClass->setWifiSsid(ssid);
-          pAppDataClass->setWifiPw(pw);
-          pAppDataClass->setNewDataFlag(DATA_UPDATE::WIFI_UPDATED);
-          // storing eeprom from main loop, since connection HAS changed and needs to work first before storing
-        }
+    if (dup && (received[i].hash == hash)) {
+      return true;
+    }
+    received[i].packetId = 0;   // the packet ID has been reused for a new message
+  }
+  received[receivedNext] = { packetId, hash };
+  receivedNext = (receivedNext + 1) % MQTT_DEDUPE_SIZE;
+  return false;
+}
+
+/*!
+ * @brief forgets the handled QoS 1 messages, a new session starts with new packet IDs
+ */
+static void clearReceived() {
+  memset(received, 0, sizeof(received));
+  receivedNext = 0;
+}
+
+/*!
+ * @brief checks the sequence number of a command against the last one of its sender
+ *
+ * a command not newer than the last one is old or repeated, a gap in the numbers is logged,
+ * sequence number 0 starts a new sequence
+ *
+ * @param seq    sequence number of the command
+ * @param last   last sequence number of the sender, updated if the command is taken
+ * @param valid  last holds a sequence number, updated as well
+ *
+ * @return true if the command is taken
+ */
+static boolean takeSeq(const uint16_t seq, uint16_t& last, boolean& valid) {
+  if (valid && (seq != 0) && ((int16_t)(seq - last) <= 0)) {
+    LOG_INFO("command %u not newer than %u, dropped", seq, last);
+    return false;
+  }
+  if (valid && (seq != 0) && (seq != (uint16_t)(last + 1))) {
+    LOG_WARN("commands missing before %u", seq);
+  }
+  last = seq;
+  valid = true;
+  return true;
+}
+
+/*!
+ * @brief gets the controller addressed by a message
+ *
+ * @param json  object holding the optional "controller" 1..HUNTER_CONTROLLERS, default 1
+ *
+ * @return index of the controller or -1 if it is invalid
+ */
+static int controllerIndex(JsonObjectConst json) {
+  int controller = json["controller"] | 1;
+  return ((controller >= 1) && (controller <= HUNTER_CONTROLLERS)) ? controller - 1 : -1;
+}
+
+/*!
+ * @brief validates a schedule entry of a config message and sets it in appData
+ *
+ * days 0 clears the slot, a zone entry needs a time of at least one minute
+ *
+ * @param json  the entry
+ *
+ * @return true if the entry is valid and set
+ */
+static boolean handleScheduleEntry(JsonObjectConst json) {
+  int slot = json["slot"] | -1;
+  int days = json["days"] | 0;
+  int controller = controllerIndex(json);
+  int hour = -1, minute = -1;
+  const char* at = json["at"];
+  if (at && (sscanf(at, "%d:%d", &hour, &minute) != 2)) {
+    hour = -1;
+  }
+  SCHEDULE_ENTRY entry = {};
+  entry.days = (byte)days;
+  entry.hour = (byte)hour;
+  entry.minute = (byte)minute;
+  entry.controller = (byte)controller;
+  boolean valid = (slot >= 0) && (slot < SCHEDULE_MAX) && (days >= 0) && (days <= 0x7f) && (controller >= 0);
+  if (valid && days) {
+    valid = (hour >= 0) && (hour < 24) && (minute >= 0) && (minute < 60);
+    if (json.containsKey("program")) {
+      int program = json["program"];
+      entry.type = HUNTER_CMD_TYPE::PROGRAM;
+      entry.program = (byte)program;
+      valid = valid && (program >= 1) && (program <= HUNTER_MAX_PROGRAM);
+    } else {
+      int zone = json["zone"] | 0;
+      int time = json["time"] | 0;
+      entry.type = HUNTER_CMD_TYPE::ZONE;
+      entry.zone = (byte)zone;
+      entry.time = (byte)time;
+      valid = valid && (zone >= 1) && (zone <= HUNTER_MAX_ZONE) && (time >= 1) && (time <= HUNTER_MAX_TIME);
+    }
+  }
+  if (!valid) {
+    LOG_WARN("invalid schedule entry");
+    return false;
+  }
+  if (!days) {
+    entry = {};
+  }
+  return pAppDataClass && pAppDataClass->setScheduleEntry((byte)slot, entry);
+}
+
+/*!
+ * @brief validates all steps of a run plan, encodes their frames and hands the plan to appData
+ *
+ * the plan is rejected as a whole if a step is invalid, an empty array cancels a running plan
+ *
+ * @param json        array of steps with zone, minutes and gap in s
+ * @param controller  index of the controller running the plan
+ *
+ * @return true if the plan is valid and set
+ */
+static boolean handlePlan(JsonArrayConst json, const byte controller) {
+  HUNTER_PLAN plan = {};
+  plan.controller = controller;
+  for (JsonObjectConst step : json) {
+    int zone = step["zone"] | 0;
+    int minutes = step["minutes"] | 0;
+    int gap = step["gap"] | 0;
+    if ((plan.count >= HUNTER_PLAN_MAX) || (zone < 1) || (zone > HUNTER_MAX_ZONE) || (minutes < 1)
+        || (minutes > HUNTER_MAX_TIME) || (gap < 0) || (gap > HUNTER_PLAN_GAP_MAX)) {
+      LOG_WARN("invalid plan, dropped");
+      return false;
+    }
+    HUNTER_PLAN_STEP& s = plan.steps[plan.count++];
+    s.frame = hunterZoneFrame((byte)zone, (byte)minutes);
+    s.zone = (byte)zone;
+    s.minutes = (byte)minutes;
+    s.gap = (uint16_t)gap;
+  }
+  if (!pAppDataClass || !pAppDataClass->setHunterPlan(plan)) {
+    return false;
+  }
+  pAppDataClass->setNewDataFlag(DATA_UPDATE::HUNTER_PLAN_UPDATED);
+  return true;
+}
+
+/*!
+ * @brief Gets the peak usage of the config arena since start
+ *
+ * @return bytes, at most getArenaCapacity()
+ */
+size_t MQTT::getArenaPeak() {
+  return configArena.peakUsed();
+}
+
+/*!
+ * @brief handles a message received on a cmd topic or by UDP, binary records go into the command queue without JSON
+ *
+ * every record is validated on its own, records not newer than the last sequence number are
+ * old or repeated and dropped, see takeSeq()
+ *
+ * @param message  received message, a multiple of sizeof(MQTT_CMD_RECORD)
+ * @param length   length of message
+ * @param source   sender of the message, each one has its own sequence
+ *
+ * @return true if all records are queued, false if one of them is dropped
+ */
+boolean handleCmdMessage(const byte* message, unsigned int length, const CMD_SOURCE source) {
+  uint16_t& lastSeq = lastCmdSeq[(byte)source];
+  boolean& seqValid = cmdSeqValid[(byte)source];
+  if ((length == 0) || (length % sizeof(MQTT_CMD_RECORD)) || !pAppDataClass) {
+    LOG_WARN("invalid binary command length: %u", length);
+    return false;
+  }
+  boolean ok = true;
+  for (unsigned int offset = 0; offset < length; offset += sizeof(MQTT_CMD_RECORD)) {
+    MQTT_CMD_RECORD record;
+    memcpy(&record, message + offset, sizeof(record));
+    uint16_t seq = (record.seqHigh << 8) | record.seqLow;
+    if (!takeSeq(seq, lastSeq, seqValid)) {
+      ok = false;
+      continue;
+    }
+
+    // the zone byte carries the controller index in its two high bits
+    byte controller = record.zone >> 6;
+    byte zone = record.zone & 0x3f;
+    HUNTER_CMD cmd = { HUNTER_CMD_TYPE::ZONE, zone, 0, 0, controller };
+    DATA_UPDATE flag = DATA_UPDATE::HUNTER_ZONE_UPDATED;
+    boolean force = (byte)record.opcode & MQTT_CMD_FORCE;
+    switch ((MQTT_CMD_OPCODE)((byte)record.opcode & ~MQTT_CMD_FORCE)) {
+      case MQTT_CMD_OPCODE::CMD_ZONE:
+        cmd.time = record.minutes;
+        break;
+      case MQTT_CMD_OPCODE::CMD_STOP:
+        break;
+      case MQTT_CMD_OPCODE::CMD_PROGRAM:
+        cmd = { HUNTER_CMD_TYPE::PROGRAM, 0, 0, zone, controller };
+        flag = DATA_UPDATE::HUNTER_PROGRAM_UPDATED;
+        break;
+      default:
+        LOG_WARN("invalid binary command opcode: %u", (unsigned)record.opcode);
+        ok = false;
+        continue;
+    }
+    if ((controller >= HUNTER_CONTROLLERS)
+        || ((cmd.type == HUNTER_CMD_TYPE::PROGRAM) ? ((cmd.program < 1) || (cmd.program > HUNTER_MAX_PROGRAM))
+            : ((cmd.zone < 1) || (cmd.zone > HUNTER_MAX_ZONE) || (cmd.time > HUNTER_MAX_TIME)))) {
+      LOG_WARN("invalid binary command %u", seq);
+      ok = false;
+      continue;
+    }
+    cmd.force = force;
+    STATS_ONLY(cmd.received = micros();)
+    if (pAppDataClass->pushHunterCmd(cmd)) {
+      pAppDataClass->setNewDataFlag(flag);
+    } else {
+      LOG_WARN("hunter command queue full, binary command dropped");
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+/*!
+ * @brief handles a message received on a config topic, of the device or of its group, or by UDP
+ *
+ * @param message   received JSON message, not zero terminated
+ * @param length  length of received message
+ * @param source  sender of the message, the device ID is not taken from the group topic
+ *
+ * @return true if the message is valid and all of its commands are taken
+ */
+boolean handleConfigMessage(const byte* message, unsigned int length, const CMD_SOURCE source) {
+  // every message starts with an empty pool, the worst case footprint is MQTT_CONFIG_ARENA
+  configArena.reset();
+  JsonDocument doc(&configArena);
+  DeserializationError error = deserializeJson(doc, (const char*)message, length);
+  if (error) {
+    LOG_WARN("deserializeJson() returned %s", error.c_str());
+    if (error == DeserializationError::NoMemory) {
+      LOG_WARN("config message exceeds MQTT_CONFIG_ARENA");
+    }
+    return false;
+  }
+  boolean ok = true;
+  // Extract the values 
+  // "wifi" array with ssid & pw
+  // "mqtt" array with ip & port
+  // "dht" array with t_offset(-3..3) & t_hold(-3.0..3.0) & h_hold(-10..10)
+  // "water" array with zone(int 1..8) & time(int 0..240 ) or  program (1..) or plan array of zone, minutes & gap
+  //   and the optional controller (1..HUNTER_CONTROLLERS), seq (1..65535), ts (s since epoch) & force
+  // "schedule" entry or array of entries with slot, days, at "hh:mm" & zone, time or program & optional controller
+  // "device" array with id & group, letters, digits, '-' and '_'
+  if (doc.containsKey("wifi") ) {
+    // handle wifi settings
+    LOG_DEBUG("wifi detected");
+    const char* ssid = doc["wifi"]["ssid"]; // "10.11.12.13"
+    const char* pw = doc["wifi"]["pw"]; // "10.11.12.13"
+    if (ssid != NULL) {
+      // update data and trigger new connect via flag
+      if (pAppDataClass) {
+        pAppDataClass->setWifiSsid(ssid);
+        pAppDataClass->setWifiPw(pw);
+        pAppDataClass->setNewDataFlag(DATA_UPDATE::WIFI_UPDATED);
+        // storing eeprom from main loop, since connection HAS changed and needs to work first before storing
       }
+    } else {
+      ok = false;
     }
-    if (doc.containsKey("mqtt") ) {
-      // handle mqtt settings
-      Serial.println("mqtt detected");
-      const char* mqtt_ip = doc["mqtt"]["ip"]; // "10.11.12.13"
-      int mqtt_port = doc["mqtt"]["port"]; // 815
-      if ((mqtt_ip != NULL) && (mqtt_port != 0)) {
-        if (pAppDataClass) {
-          pAppDataClass->setMqttIp(mqtt_ip);
-          pAppDataClass->setMqttPort(mqtt_port);
-          pAppDataClass->setNewDataFlag(DATA_UPDATE::MQTT_UPDATED);  
-          // storing eeprom from main loop, since connection HAS changed and needs to work first before storing
-        }
+  }
+  if (doc.containsKey("mqtt") ) {
+    // handle mqtt settings
+    LOG_DEBUG("mqtt detected");
+    const char* mqtt_ip = doc["mqtt"]["ip"]; // "10.11.12.13"
+    int mqtt_port = doc["mqtt"]["port"]; // 815
+    if ((mqtt_ip != NULL) && (mqtt_port != 0)) {
+      if (pAppDataClass) {
+        pAppDataClass->setMqttIp(mqtt_ip);
+        pAppDataClass->setMqttPort(mqtt_port);
+        pAppDataClass->setNewDataFlag(DATA_UPDATE::MQTT_UPDATED);  
+        // storing eeprom from main loop, since connection HAS changed and needs to work first before storing
       }
+    } else {
+      ok = false;
     }
-    if (doc.containsKey("dht")) {
-      // handle dht settings
-      Serial.println("dht detected");
-      if (doc["dht"].containsKey("t_offset")) {
-        if (pAppDataClass) {
-          int dht_t_offset = doc["dht"]["t_offset"];
-          pAppDataClass->setDhtTempOffset(dht_t_offset);
-          pAppDataClass->setNewDataFlag(DATA_UPDATE::DHT_UPDATED);
-        }
+  }
+  if (doc.containsKey("device")) {
+    // handle device ID and group, they name the client and the topics
+    LOG_DEBUG("device detected");
+    // one ID for all devices of a group would make their client IDs collide
+    const char* id = (source == CMD_SOURCE::SRC_GROUP) ? nullptr : (const char*)doc["device"]["id"];
+    const char* deviceGroup = doc["device"]["group"];
+    if (pAppDataClass) {
+      id = id ? id : pAppDataClass->getDeviceId();
+      deviceGroup = deviceGroup ? deviceGroup : pAppDataClass->getDeviceGroup();
+    }
+    if (!id || !deviceGroup || !APP_DATA::validDeviceName(id, DEVICE_ID_LEN)
+        || !APP_DATA::validDeviceName(deviceGroup, DEVICE_GROUP_LEN)) {
+      LOG_WARN("invalid device id or group");
+      ok = false;
+    } else {
+      pAppDataClass->setDeviceId(id);
+      pAppDataClass->setDeviceGroup(deviceGroup);
+      // the client reconnects with the new ID and topics, stored by the next successful connection
+      pAppDataClass->setNewDataFlag(DATA_UPDATE::MQTT_UPDATED);
+    }
+  }
+  if (doc.containsKey("dht")) {
+    // handle dht settings
+    LOG_DEBUG("dht detected");
+    if (doc["dht"].containsKey("t_offset")) {
+      if (pAppDataClass) {
+        int dht_t_offset = doc["dht"]["t_offset"];
+        pAppDataClass->setDhtTempOffset(dht_t_offset);
+        pAppDataClass->setNewDataFlag(DATA_UPDATE::DHT_UPDATED);
       }
-      if (doc["dht"].containsKey("t_hold")) {
-        if (pAppDataClass) {
-          float dht_t_level = doc["dht"]["t_hold"];
-          pAppDataClass->setDhtTempLevel(dht_t_level);
-          pAppDataClass->setNewDataFlag(DATA_UPDATE::DHT_UPDATED);
-        }
+    }
+    if (doc["dht"].containsKey("t_hold")) {
+      if (pAppDataClass) {
+        float dht_t_level = doc["dht"]["t_hold"];
+        pAppDataClass->setDhtTempLevel(dht_t_level);
+        pAppDataClass->setNewDataFlag(DATA_UPDATE::DHT_UPDATED);
       }
-      if (doc["dht"].containsKey("h_hold")) {
-        if (pAppDataClass) {
-          int dht_h_level = doc["dht"]["h_hold"];
-          pAppDataClass->setDhtHumLevel(dht_h_level);
-          pAppDataClass->setNewDataFlag(DATA_UPDATE::DHT_UPDATED);
-        }
+    }
+    if (doc["dht"].containsKey("h_hold")) {
+      if (pAppDataClass) {
+        int dht_h_level = doc["dht"]["h_hold"];
+        pAppDataClass->setDhtHumLevel(dht_h_level);
+        pAppDataClass->setNewDataFlag(DATA_UPDATE::DHT_UPDATED);
+      }
+    }
+    pAppDataClass->storeEEProm(); // store eeprom data with the next commit, since connection has not changed, only params
+  }
+  if (doc.containsKey("schedule")) {
+    // handle entries of the local watering schedule
+    LOG_DEBUG("schedule detected");
+    if (doc["schedule"].is<JsonArray>()) {
+      for (JsonObject entry : doc["schedule"].as<JsonArray>()) {
+        ok = handleScheduleEntry(entry) && ok;
       }
-      pAppDataClass->storeEEProm(); // store eeprom data right now, since connection has not changed, only params
+    } else {
+      ok = handleScheduleEntry(doc["schedule"].as<JsonObject>()) && ok;
     }
-    if (doc.containsKey("water")) {
-      // handle hunter watering settings
-      Serial.println("water detected");
-      if (doc["water"].containsKey("zone") && doc["water"].containsKey("time")) {
-        int zone = doc["water"]["zone"];
-        int time = doc["water"]["time"];
-        if (pAppDataClass) {
-          pAppDataClass->setHunterZone(zone);
-          pAppDataClass->setHunterTime(time);
+    if (pAppDataClass) {
+      pAppDataClass->storeEEProm();
+    }
+  }
+  if (doc.containsKey("water")) {
+    // handle hunter watering settings
+    LOG_DEBUG("water detected");
+    // commands are queued, HUNTER_CTRL takes them as soon as the bus is free
+    int controller = controllerIndex(doc["water"]);
+    uint32_t stamp = doc["water"]["ts"] | 0UL;
+    boolean force = doc["water"]["force"] | false;
+    if (controller < 0) {
+      LOG_WARN("invalid controller");
+      ok = false;
+    } else if (doc["water"].containsKey("seq")
+               && !takeSeq(doc["water"]["seq"].as<uint16_t>(), lastWaterSeq[(byte)source], waterSeqValid[(byte)source])) {
+      // old or repeated message, already handled
+      ok = false;
+    } else if (doc["water"].containsKey("plan")) {
+      ok = handlePlan(doc["water"]["plan"].as<JsonArrayConst>(), (byte)controller) && ok;
+    } else if (doc["water"].containsKey("zone") && doc["water"].containsKey("time")) {
+      int zone = doc["water"]["zone"];
+      int time = doc["water"]["time"];
+      if ((zone < 1) || (zone > HUNTER_MAX_ZONE) || (time < 0) || (time > HUNTER_MAX_TIME)) {
+        LOG_WARN("invalid zone or time");
+        ok = false;
+      } else if (pAppDataClass) {
+        HUNTER_CMD cmd = { HUNTER_CMD_TYPE::ZONE, (byte)zone, (byte)time, 0, (byte)controller, force, stamp };
+        STATS_ONLY(cmd.received = micros();)
+        if (pAppDataClass->pushHunterCmd(cmd)) {
           pAppDataClass->setNewDataFlag(DATA_UPDATE::HUNTER_ZONE_UPDATED);
+        } else {
+          LOG_WARN("hunter command queue full, zone command dropped");
+          ok = false;
         }
-      } else if (doc["water"].containsKey("program")) {
-        int program = doc["water"]["program"];
-        if (pAppDataClass) {
-          pAppDataClass->setHunterProgram(program);
+      }
+    } else if (doc["water"].containsKey("program")) {
+      int program = doc["water"]["program"];
+      if ((program < 1) || (program > HUNTER_MAX_PROGRAM)) {
+        LOG_WARN("invalid program");
+        ok = false;
+      } else if (pAppDataClass) {
+        HUNTER_CMD cmd = { HUNTER_CMD_TYPE::PROGRAM, 0, 0, (byte)program, (byte)controller, force, stamp };
+        STATS_ONLY(cmd.received = micros();)
+        if (pAppDataClass->pushHunterCmd(cmd)) {
           pAppDataClass->setNewDataFlag(DATA_UPDATE::HUNTER_PROGRAM_UPDATED);
+        } else {
+          LOG_WARN("hunter command queue full, program command dropped");
+          ok = false;
         }
       }
-    }      
+    } else {
+      LOG_WARN("water without zone and time, program or plan");
+      ok = false;
+    }
   }
+  return ok;
 }
 
 /*!
- * @brief init the MQTT client, connects it and register the MQTT subsciption callback
+ * @brief init the MQTT client and register the MQTT subsciption callback
+ *
+ * does not block, the connection is established by loop() with the next attempt right away
  *
- * @return success or failure of connection to broker
+ * @return success or failure if not correct initialized
  */
  boolean MQTT::initMqttServer() {
-  char msg[40] = "Trying MQTT ";
-
   if (!appData) {
-    Serial.println("no valid appData pointer");
+    LOG_ERROR("no valid appData pointer");
     return false;
   }
-  strcat(msg, appData->getMqttIp().toString().c_str());
-  strcat(msg, " ...");
-  if (oled) {oled->updateAction(msg);}
+  IP_STRING brokerIp = ipString(appData->getMqttIp());
+  FIXED_STRING<MAX_CHAR_IN_LINE> msg;
+  msg.format("Trying MQTT %s ...", brokerIp.c_str());
+  if (oled) {oled->updateAction(msg.c_str());}
 
+  buildTopics();            // device ID or group may have changed
   mqttClient.disconnect(); // disconnect potential previous connection
   mqttClient.setServer(appData->getMqttIp(), appData->getMqttPort());
   mqttClient.setCallback(mqttSubscriptionCallback);
+  // the merged value message does not fit into the default MQTT_MAX_PACKET_SIZE
+  mqttClient.setBufferSize(MQTT_CLIENT_BUFFER);
+  // a connection attempt blocks, keep it short
+  mqttClient.setSocketTimeout(MQTT_ATTEMPT_TIMEOUT);
+  hunterClient.setTimeout(MQTT_CONNECT_TIMEOUT);
+
+  if (oled) { oled->updateMqttInfo(brokerIp.c_str(), appData->getMqttPort(), false);}
+
+  LOG_DEBUG("initMqttServer -> connect with next loop");
+  // new parameters, the next connection is not resumed and stores them
+  sessionValid = false;
+  state = MQTT_STATE::BROKER_BACKOFF;
+  failedAttempts = 0;
+  nextAttempt = millis();
+  STATS_ONLY(downSince = millis();)
 
-  if (oled) { oled->updateMqttInfo(appData->getMqttIp().toString().c_str(), appData->getMqttPort(), false);}
-
-  Serial.println("initMqttServer -> reconnect");
-  boolean result = this->reconnect();
-  
-  return result;
+  return true;
 }
 
 /*!
  * @brief loop called periodically to maintain MQTT connection 
  *
- * inits the MQTT Client if not connected and reconnect if connection is broken
+ * runs the connection state machine, never blocks longer than one connection attempt
+ *   - BROKER_CONNECTED: handles received messages, on a lost connection waits for a retry
+ *   - BROKER_BACKOFF: tries to connect when the backoff time is over and WIFI is up
  */
 void MQTT::loop () {
-  if (!mqttClient.connected()) {
-    initMqttServer();
+  switch (state) {
+    case MQTT_STATE::BROKER_CONNECTED:
+      if (!mqttClient.loop()) {
+        mqttClient.disconnect();
+        LOG_WARN("mqtt loop failed, reconnect ..");
+        if (oled && appData) { oled->updateMqttInfo(ipString(appData->getMqttIp()).c_str(), appData->getMqttPort(), false);}
+        state = MQTT_STATE::BROKER_BACKOFF;
+        nextAttempt = millis();
+        STATS_ONLY(downSince = millis();)
+      }
+      break;
+    case MQTT_STATE::BROKER_BACKOFF:
+      if (WiFi.isConnected() && ((int32_t)(millis() - nextAttempt) >= 0)) {
+        reconnect();
+      }
+      break;
+    default:
+      break;
   }
-  if(!mqttClient.loop()) {
-    mqttClient.disconnect();
-    Serial.println("mqtt loop failed, reconnect ..");
-    reconnect();
-  } 
 }
 
 /*!
- * @brief Publishes the parameter used to adjust the DHT sensor to broker 
+ * @brief checks for received data without processing it
  *
- * @param temp_level  level of temperatur change triggering a value update to broker
- * @param hum_level   level of humidity change triggering a value update to broker
- * @param temp_offset  the offset to the measured temperatur
- *
- * @return success or failure 
+ * @return true if data is waiting to be handled by loop()
  */
-boolean MQTT::publishDHTParams(const float temp_level, const int hum_level, const int temp_offset) {
-  JsonDocument doc;
-  doc["dht"]["temp_offset"] = temp_offset;
-  doc["dht"]["temp_level"] = temp_level;
-  doc["dht"]["hum_level"] = hum_level;
-
-  char output[256];
-  serializeJson(doc, output);
-
-  Serial.println("Publishing DHT parameter");
-
-  return _publish("value", output);
-}
-
-/*!
- * @brief Publishes the temperature and humidity values from DHT sensor 
- *
- * @param temp temperatur
- * @param humidity 
- *
- * @return success or failure 
- */
-boolean MQTT::publishDHT(const float temp, const float humidity) {
-  JsonDocument doc;
-  doc["dht"]["temp"] = temp;
-  doc["dht"]["humidity"] = humidity;
-
-  char output[256];
-  serializeJson(doc, output);
-
-  Serial.println("Publishing DHT values");
-  // show action on OLED
-  if (oled) {oled->updateAction("Publishing DHT values");}     
-
-  return _publish("value", output);
+boolean MQTT::dataAvailable() {
+  return hunterClient.available() > 0;
 }
 
 /*!
- * @brief Publishes the working MQTT parameter to broker 
+ * @brief Publishes a serialized JSON document to a MQTT broker 
  *
- * @param port MQTT broker port
- * @param ip   MQTT broker IP address
+ * @param topic  topic from the topic table
+ * @param json   writer holding the payload, usually taken from payloadWriter()
  *
  * @return success or failure 
  */
-boolean MQTT::publishMQTT(const char* ip, const int port) {
-  JsonDocument doc;
-  doc["broker"]["ip"] = ip;
-  doc["broker"]["port"] = port;
-
-  char output[256];
-  serializeJson(doc, output);
-
-  Serial.println("Publishing MQTT settings");
-  // show action on OLED
-  if (oled) {oled->updateAction("Publishing MQTT values");}     
-
-  return _publish("value", output);
+boolean MQTT::publish(const MQTT_TOPIC topic, const JSON_WRITER& json) {
+  if (json.overflowed()) {
+    LOG_ERROR("MQTT payload too long, publish canceled");
+    return false;
+  }
+  return _publish(topic, (const uint8_t*)json.c_str(), json.length());
 }
 
 /*!
- * @brief Publishes the working WIFI parameter to broker 
+ * @brief Publishes a log message on PRE_MQTT/log, used as mirror of the logger
  *
- * @param ssid WIFI SSID
- * @param ip   WIFI DHCP IP address
+ * @param line  zero terminated message
  *
- * @return success or failure 
+ * @return true if published, false if the message shall be kept for later
  */
-boolean MQTT::publishWIFI(const char* ssid, const char* ip) {
-  JsonDocument doc;
-  doc["wifi"]["ssid"] = ssid;
-  doc["wifi"]["ip"] = ip;
-
-  char output[256];
-  serializeJson(doc, output);
-
-  Serial.println("Publishing WIFI settings");
-  // show action on OLED
-  if (oled) {oled->updateAction("Publishing WIFI values");}     
-
-  return _publish("value", output);
+boolean MQTT::publishLog(const char* line) {
+  if (state != MQTT_STATE::BROKER_CONNECTED) {
+    return false;
+  }
+  return _publish(MQTT_TOPIC::LOG, (const uint8_t*)line, strlen(line));
 }
 
 // ================================ Private functions ==================================
 
 /*!
- * @brief This functions reconnects your ESP8266 to your MQTT broker and it subscribes to topics
+ * @brief This functions makes one attempt to connect your ESP8266 to your MQTT broker and it subscribes to topics
  * Change the function below if you want to subscribe to more topics with your ESP8266 
- * 5 connections tries are made, if successfull, working WIFI and MQTT parameters are stored in EEprom
- * and published to broker
+ * if the attempt fails, the next one is scheduled with an exponential backoff
  *
  * @return success or failure 
  */
 boolean MQTT::reconnect() {
   if (!appData) {
-    Serial.println("no valid appData pointer");
+    LOG_ERROR("no valid appData pointer");
     return false;
   }
 
-  char mqttServerIp[30];
-  strcpy(mqttServerIp, appData->getMqttIp().toString().c_str());
-  
-  // Loop until we're reconnected
-  int loopCnt = 0;
-
-  while (!mqttClient.connected()) {
-    if (loopCnt++ > 4) {
-      return false;
-    }
-    Serial.print("Attempting MQTT connection...");
-    if (oled) {oled->updateAction("Connecting to MQTT ..."); }
-
-    // Attempt to connect
-    /*
-     YOU MIGHT NEED TO CHANGE THIS LINE, IF YOU'RE HAVING PROBLEMS WITH MQTT MULTIPLE CONNECTIONS
-     To change the ESP device ID, you will have to give a new name to the ESP8266.
-     Here's how it looks:
-       if (client.connect("ESP8266Client")) {
-     You can do it like this:
-       if (client.connect("ESP1_Office")) {
-     Then, for the other ESP:
-       if (client.connect("ESP2_Garage")) {
-      That should solve your MQTT multiple connections problem
-    */
-    if (mqttClient.connect("ESP_Hunter", MQTT_username, MQTT_password)) {
-      Serial.println("connected");  
-      // Subscribe or resubscribe to a topic
-      // You can subscribe to more topics (to control more LEDs in this example)
-      mqttClient.subscribe((PRE_MQTT + String("/") + String("config")).c_str());
-      if (oled) {oled->updateMqttInfo(mqttServerIp, appData->getMqttPort(), true);}
-    } else {
-      Serial.print("failed, rc=");
-      Serial.print(mqttClient.state());
-      Serial.println(" try again in 5 seconds");
-      // Wait 5 seconds before retrying
-      delay(5000);
-    }
+  IP_STRING mqttServerIp = ipString(appData->getMqttIp());
+
+  LOG_INFO("Attempting MQTT connection...");
+  if (oled) {oled->updateAction("Connecting to MQTT ..."); }
+
+  // Attempt to connect
+  /*
+   YOU MIGHT NEED TO CHANGE THIS LINE, IF YOU'RE HAVING PROBLEMS WITH MQTT MULTIPLE CONNECTIONS
+   To change the ESP device ID, you will have to give a new name to the ESP8266.
+   Here's how it looks:
+     if (client.connect("ESP8266Client")) {
+   You can do it like this:
+     if (client.connect("ESP1_Office")) {
+   Then, for the other ESP:
+     if (client.connect("ESP2_Garage")) {
+    That should solve your MQTT multiple connections problem
+  */
+  STATS_START(attemptStart);
+  // no clean session, the broker keeps the subscription and queues QoS 1 commands while the device is offline
+  boolean connected = mqttClient.connect(clientId, MQTT_username, MQTT_password, nullptr, 0, false, nullptr, false);
+  STATS_STOP(MQTT_CONNECT, attemptStart);
+  if (!connected) {
+    LOG_WARN("MQTT connection failed, rc=%d", mqttClient.state());
+    STATS_COUNT(MQTT_FAILS);
+    scheduleRetry();
+    return false;
+  }
+  STATS_COUNT(MQTT_CONNECTS);
+  STATS_RECORD(MQTT_DOWN, millis() - downSince);
+
+  // same broker as the previous connection, its session and the stored parameters are still valid
+  resumed = sessionValid && (sessionIp == appData->getMqttIp()) && (sessionPort == appData->getMqttPort());
+  sessionValid = true;
+  sessionIp = appData->getMqttIp();
+  sessionPort = appData->getMqttPort();
+  if (!resumed) {
+    // PubSubClient does not report the session present flag of CONNACK, a new broker has no session of this client
+    clearReceived();
   }
-  if (oled) {oled->updateAction("MQTT connected");} 
-
-  // WIFI and MQTT is connected, can be stored to EEProm
-  appData->storeEEProm();
 
-  // Publishes WIFI IP address since MQTT is now connected
-  publishWIFI( appData->getWifiSsid(), appData->getWifiIp().toString().c_str() );
-  // Publish MQTT setting
-  publishMQTT( appData->getMqttIp().toString().c_str(), appData->getMqttPort());
+  LOG_INFO("MQTT %s as %s", resumed ? "session resumed" : "connected", clientId);
+  // Subscribe or resubscribe to a topic, PubSubClient does not tell if the broker still has the session
+  for (const MQTT_SUBSCRIPTION& sub : subscriptions) {
+    subscribe(sub, true);
+  }
+  if (oled) {oled->updateMqttInfo(mqttServerIp.c_str(), appData->getMqttPort(), true);}
+  state = MQTT_STATE::BROKER_CONNECTED;
+  failedAttempts = 0;
+  onConnected();
 
   return true;
 }
 
 /*!
- * @brief Publishes a payload to a MQTT broker 
+ * @brief schedules the next connection attempt 
  *
- * @param topic MQTT topic, will be prepended with define PRE_MQTT/topic
- * @param payload char pointer to mqtt payload message
+ * the delay doubles with every failed attempt from MQTT_BACKOFF_MIN up to MQTT_BACKOFF_MAX,
+ * half of it is random, so a fleet of devices does not retry in lockstep after a broker outage
+ */
+void MQTT::scheduleRetry() {
+  if (failedAttempts < 0xffff) {
+    failedAttempts++;
+  }
+  uint32_t backoff = MQTT_BACKOFF_MIN;
+  for (uint16_t i = 1; (i < failedAttempts) && (backoff < MQTT_BACKOFF_MAX); i++) {
+    backoff *= 2;
+  }
+  if (backoff > MQTT_BACKOFF_MAX) {
+    backoff = MQTT_BACKOFF_MAX;
+  }
+  // hardware random generator, rand() has the same seed on every device
+  uint32_t delayMs = backoff / 2 + secureRandom(backoff / 2);
+  nextAttempt = millis() + delayMs;
+  state = MQTT_STATE::BROKER_BACKOFF;
+
+  char msg[40];
+  snprintf(msg, sizeof(msg), "MQTT retry in %lu s", (unsigned long)(delayMs / 1000));
+  LOG_INFO("%s", msg);
+  if (oled) {oled->updateAction(msg);}
+}
+
+/*!
+ * @brief work to be done after each successful connection 
  *
- * @return success or failure 
+ * working WIFI and MQTT parameters are stored in EEprom
  */
- boolean MQTT::_publish(const char* topic, const char* payload) {
-  if (!mqttClient.connected()) {
-    Serial.println("MQTT not connected, publish canceled");
-    return false;
+void MQTT::onConnected() {
+  if (oled) {oled->updateAction(resumed ? "MQTT resumed" : "MQTT connected");} 
+  if (resumed) {
+    // the parameters have been stored with the first connection of the session
+    return;
   }
-  return mqttClient.publish(addOrigin(topic).c_str(), payload);
-}  
+
+  // WIFI and MQTT is connected, can be stored to EEProm, nothing is written if it is unchanged
+  appData->confirmConnection();
+  // WIFI and MQTT parameter are published by TELEMETRY when it sees the connection
+}
 
 /*!
  * @brief Publishes a payload to a MQTT broker 
  *
- * @param topic MQTT topic, will be prepended with define PRE_MQTT/topic
+ * @param topic  topic from the topic table
  * @param payload pointer to data bytes
  * @param length length of payload
  *
  * @return success or failure 
  */
-boolean MQTT::_publish(const char* topic, const uint8_t* payload, unsigned int length) {
+boolean MQTT::_publish(const MQTT_TOPIC topic, const uint8_t* payload, unsigned int length) {
   if (!mqttClient.connected()) {
-    Serial.println("MQTT not connected, publish canceled");
+    LOG_DEBUG("MQTT not connected, publish canceled");
     return false;
   }
-  return mqttClient.publish(addOrigin(topic).c_str(), payload, length);
+  return mqttClient.publish(this->topic(topic), payload, length);
 } 
 
-const String MQTT::addOrigin(const char* topic) {
-  return( PRE_MQTT + String("/") + String(topic) );
-} 
+/*!
+ * @brief gets the subscription of a received topic
+ *
+ * @param topic  zero terminated topic
+ *
+ * @return the subscription, nullptr if the topic is not subscribed
+ */
+const MQTT_SUBSCRIPTION* MQTT::route(const char* topic) const {
+  uint32_t hash = topicHash(topic);
+  for (const MQTT_SUBSCRIPTION& sub : subscriptions) {
+    // a hash collision must not be taken for a command
+    if ((sub.hash == hash) && sub.topic[0] && (strcmp(sub.topic, topic) == 0)) {
+      return &sub;
+    }
+  }
+  return nullptr;
+}
+
+/*!
+ * @brief builds the client ID and the full topics PRE_MQTT/<device ID>/name, publishing only looks them up
+ *
+ * the subscriptions of a previous group are removed from the persistent session
+ */
+void MQTT::buildTopics() {
+  if (!appData) {
+    return;
+  }
+  snprintf(clientId, sizeof(clientId), "%s_%s", MQTT_CLIENT_PREFIX, appData->getDeviceId());
+  for (byte i = 0; i < (byte)MQTT_TOPIC::COUNT; i++) {
+    snprintf(topics[i], MQTT_TOPIC_LEN, "%s/%s/%s", PRE_MQTT, appData->getDeviceId(), TOPIC_NAMES[i]);
+  }
+
+  const MQTT_TOPIC handlers[] = { MQTT_TOPIC::CONFIG, MQTT_TOPIC::CMD };
+  for (byte i = 0; i < 2; i++) {
+    MQTT_SUBSCRIPTION& device = subscriptions[i];
+    MQTT_SUBSCRIPTION& group = subscriptions[2 + i];
+    strlcpy(device.topic, topic(handlers[i]), MQTT_TOPIC_LEN);
+    char groupTopic[MQTT_TOPIC_LEN] = "";
+    if (appData->getDeviceGroup()[0]) {
+      snprintf(groupTopic, sizeof(groupTopic), "%s/%s/%s/%s", PRE_MQTT, MQTT_GROUP_LEVEL, appData->getDeviceGroup(),
+               TOPIC_NAMES[(byte)handlers[i]]);
+    }
+    if (strcmp(group.topic, groupTopic) != 0) {
+      subscribe(group, false);
+    }
+    strlcpy(group.topic, groupTopic, MQTT_TOPIC_LEN);
+    device.handler = group.handler = handlers[i];
+    device.group = false;
+    group.group = true;
+    device.hash = topicHash(device.topic);
+    group.hash = topicHash(group.topic);
+  }
+}
+
+/*!
+ * @brief subscribes or unsubscribes a topic, a group topic as shared subscription if MQTT_SHARED_GROUP is set
+ *
+ * the broker hands a message of a shared subscription to one device of the group, it arrives with the plain topic
+ *
+ * @param sub  the subscription, nothing is done if its topic is empty
+ * @param on   true to subscribe, false to unsubscribe
+ */
+void MQTT::subscribe(const MQTT_SUBSCRIPTION& sub, const boolean on) {
+  if (!sub.topic[0] || !mqttClient.connected()) {
+    return;
+  }
+  char filter[MQTT_TOPIC_LEN + sizeof(PRE_MQTT) + 8];
+  snprintf(filter, sizeof(filter), (MQTT_SHARED_GROUP && sub.group) ? "$share/" PRE_MQTT "/%s" : "%s", sub.topic);
+  if (on) {
+    mqttClient.subscribe(filter, MQTT_CONFIG_QOS);
+  } else {
+    mqttClient.unsubscribe(filter);
+  }
+}
@@ -15,33 +15,168 @@
 #include "ESP8266WiFi.h" //https://randomnerdtutorials.com/how-to-install-esp8266-board-arduino-ide/
 #include "oled.h"
 #include "app_data.h"
+#include "json_writer.h"
+#include "json_arena.h"
+#include "stats.h"
 
 #define MQTT_SERVER_IP    "MQTT SERVER IP ADDRESS"  // default MQTT broker IP
 #define MQTT_SERVER_PORT  MQTT_SERVER_PORT               // default MQTT broker port
 
-#define PRE_MQTT          "hunter"          // preamble of all MQTT topics
+#define PRE_MQTT          "hunter"          // preamble of all MQTT topics, a device uses PRE_MQTT/<device ID>/<name>
+#define MQTT_GROUP_LEVEL  "group"           // config and cmd of a group are PRE_MQTT/group/<group>/<name>
+#define MQTT_SHARED_GROUP false             // true subscribes the group as $share/PRE_MQTT/..., one device takes each message
+
+#define MQTT_TOPIC_LEN        48      // max length of a full topic incl. PRE_MQTT, device ID and group
+#define MQTT_PUBLISH_BUFFER   512     // bytes of a published payload
+#define MQTT_CLIENT_BUFFER    (MQTT_PUBLISH_BUFFER + MQTT_TOPIC_LEN + 8)   // packet buffer of PubSubClient, payload, topic and header
+
+// static memory parsing a config message, the only JSON document of the application, published values use JSON_WRITER.
+// A config message fits into MQTT_CLIENT_BUFFER, 6 bytes of pool per received byte hold slots, pool pages and copied strings
+#define MQTT_ARENA_PER_BYTE   6
+#define MQTT_CONFIG_ARENA     ((MQTT_CLIENT_BUFFER * MQTT_ARENA_PER_BYTE + JSON_ARENA_ALIGN - 1) & ~(JSON_ARENA_ALIGN - 1))
+
+#define MQTT_BACKOFF_MIN      1000    // ms, delay after the first failed connection attempt
+#define MQTT_BACKOFF_MAX      60000   // ms, upper limit of the exponential backoff
+#define MQTT_ATTEMPT_TIMEOUT  2       // s, limits the time a connection attempt blocks
+#define MQTT_CONNECT_TIMEOUT  2000    // ms, TCP connect timeout of the client
+
+#define MQTT_CLIENT_PREFIX    "ESP_Hunter"  // client ID is the prefix and the device ID, the broker keeps a session per ID
+#define MQTT_CLIENT_ID_LEN    (sizeof(MQTT_CLIENT_PREFIX) + DEVICE_ID_LEN)
+#define MQTT_CONFIG_QOS       1       // commands are delivered at least once, kept by the broker while disconnected
+#define MQTT_DEDUPE_SIZE      8       // QoS 1 messages remembered to drop redeliveries
+#define MQTT_HEADER_DUP       0x08    // DUP flag in the fixed header of a PUBLISH packet, set on a redelivery
+
+/*!
+ *  @brief  Topics used by the application, index into the topic table.
+ */
+enum class MQTT_TOPIC : byte {
+  VALUE   = 0,    // published values
+  CONFIG  = 1,    // subscribed configuration and commands
+  HISTORY = 2,    // published sensor history
+  STATS   = 3,    // published run time statistics
+  LOG     = 4,    // mirrored log messages
+  CMD     = 5,    // subscribed binary commands
+  COUNT           // number of topics
+};
+
+#define MQTT_SUBSCRIPTIONS    4       // config and cmd of the device and of its group
+
+/*!
+ *  @brief  Struct for a subscribed topic, a received message is routed by the hash of its topic.
+ */
+typedef struct {
+  char        topic[MQTT_TOPIC_LEN];    // empty if not subscribed
+  uint32_t    hash;                     // topicHash() of topic
+  MQTT_TOPIC  handler;                  // CONFIG or CMD
+  boolean     group;                    // topic of the device group
+} MQTT_SUBSCRIPTION;
+
+/*!
+ *  @brief  Opcodes of a binary command record.
+ */
+enum class MQTT_CMD_OPCODE : byte {
+  CMD_ZONE    = 1,    // start zone for minutes, 0 minutes stops it
+  CMD_PROGRAM = 2,    // start program, zone holds the program number
+  CMD_STOP    = 3,    // stop zone
+};
+
+#define MQTT_CMD_FORCE        0x80    // opcode flag, the frame is sent even if it repeats the state of the bus
+
+/*!
+ *  @brief  Struct for a binary command record on the cmd topic, a message carries one or more records.
+ */
+typedef struct __attribute__((packed)) {
+  MQTT_CMD_OPCODE opcode;
+  byte            zone;       // bits 0..5 zone 1..48 or program 1..4, bits 6..7 controller index
+  byte            minutes;    // 0..240, CMD_ZONE only
+  byte            seqHigh;    // sequence number of the sender, big endian, 0 restarts the sequence
+  byte            seqLow;
+} MQTT_CMD_RECORD;
+
+static_assert(sizeof(MQTT_CMD_RECORD) == 5, "MQTT_CMD_RECORD is a wire format");
+
+/*!
+ *  @brief  Senders of commands, each one counts its own sequence numbers.
+ */
+enum class CMD_SOURCE : byte {
+  SRC_DEVICE  = 0,    // config and cmd topic of the device
+  SRC_GROUP   = 1,    // config and cmd topic of the device group
+  SRC_UDP     = 2,    // authenticated datagrams of the UDP listener
+  SRC_COUNT           // number of sources
+};
+
+// handlers of the subscribed topics, the UDP listener hands the same formats to them and reports the result
+boolean handleConfigMessage(const byte* message, unsigned int length, const CMD_SOURCE source);
+boolean handleCmdMessage(const byte* message, unsigned int length, const CMD_SOURCE source);
+
+/*!
+ *  @brief  States of the connection state machine.
+ */
+enum class MQTT_STATE : byte {
+  BROKER_IDLE       = 0,    // not initialized
+  BROKER_BACKOFF    = 1,    // disconnected, waiting for the next attempt
+  BROKER_CONNECTED  = 2,
+};
 
 class MQTT {
 public:
 	// constructor
-	MQTT() : oled(nullptr), appData(nullptr) {}
+	MQTT() : oled(nullptr), appData(nullptr), state(MQTT_STATE::BROKER_IDLE), failedAttempts(0), nextAttempt(0),
+           resumed(false), sessionValid(false), sessionPort(0), clientId{}, topics{}, subscriptions{} {}
 	// public methods
-  boolean publishDHT(const float temp, const float humidity);
-  boolean publishDHTParams(const float temp_level, const int hum_level, const int temp_offset);
-  boolean publishMQTT(const char* ip, const int port);
-  boolean publishWIFI(const char* ssid, const char* ip);
+  JSON_WRITER payloadWriter() { return JSON_WRITER(publishBuffer, sizeof(publishBuffer)); }
+  boolean publish(const MQTT_TOPIC topic, const JSON_WRITER& json);
+  boolean publishLog(const char* line);
   void    initialize(OLED* oled, APP_DATA* appData);
   boolean initMqttServer();
   void    loop();
+  boolean dataAvailable();
+  MQTT_STATE getState() const { return state; }
+  boolean isResumed() const { return resumed; }
+  const char* getClientId() const { return clientId; }
+  const MQTT_SUBSCRIPTION* route(const char* topic) const;
+  static size_t getArenaPeak();
+  static size_t getArenaCapacity() { return MQTT_CONFIG_ARENA; }
+  uint16_t   getFailedAttempts() const { return failedAttempts; }
   void    print();
 
 private:
   boolean   reconnect();
-  boolean   _publish(const char* topic, const char* payload);
-  boolean   _publish(const char* topic, const uint8_t* payload, unsigned int length);
-  const String addOrigin(const char* topic);
+  void      scheduleRetry();
+  void      onConnected();
+  boolean   _publish(const MQTT_TOPIC topic, const uint8_t* payload, unsigned int length);
+  void      buildTopics();
+  void      subscribe(const MQTT_SUBSCRIPTION& sub, const boolean on);
+  const char* topic(const MQTT_TOPIC topic) const { return topics[(byte)topic]; }
   OLED*     oled;
   APP_DATA* appData;
+  MQTT_STATE  state;
+  uint16_t    failedAttempts;   // since the last successful connection
+  uint32_t    nextAttempt;      // millis() of the next connection attempt
+  boolean     resumed;          // the connection continues the session of the previous one with the same broker
+  boolean     sessionValid;     // a session was established since start
+  IPAddress   sessionIp;        // broker of the session
+  int         sessionPort;
+  char        clientId[MQTT_CLIENT_ID_LEN];
+  char        topics[(byte)MQTT_TOPIC::COUNT][MQTT_TOPIC_LEN];    // full topics, built with each new parameter set
+  MQTT_SUBSCRIPTION subscriptions[MQTT_SUBSCRIPTIONS];
+  char        publishBuffer[MQTT_PUBLISH_BUFFER];                 // payload of the message going out
+#if USE_STATS
+  uint32_t    downSince = 0;    // millis() the broker connection was lost
+#endif
 };
 
+/*!
+ *  @brief  FNV-1a hash of a topic.
+ *  @param  topic  zero terminated topic
+ *  @return The 32 bit hash.
+ */
+constexpr uint32_t topicHash(const char* topic) {
+  uint32_t hash = 2166136261UL;
+  while (*topic) {
+    hash = (hash ^ (uint8_t)*topic++) * 16777619UL;
+  }
+  return hash;
+}
+
 #endif // MQTT_H
@@ -25,17 +25,22 @@
  */
 
 #include "OLED.h"
+#include "stats.h"
 
 #define PAGE_DURATION 2000     // time to alter display pages in ms
+#define DISPLAY_WIDTH 128
+
+// top of each line on the display, the last entry is the bottom of the display
+static const int16_t LINE_Y[MAX_LINES + 1] = { 0, 13, 25, 38, 51, 64 };
 
 /*!
  *  @brief  Setup OLED lines buffer and initialize display class.
  */
 void OLED::initialize() {
-  for (int i = 1; i < ARRAY_LEN; i++) {
-    strncpy(lines[i], "", MAX_CHAR_IN_LINE - 1);
+  for (int i = 0; i < ARRAY_LEN; i++) {
+    lines[i][0] = '\0';
   }
-  dataChanged = true;
+  dirtyLines = (1 << ARRAY_LEN) - 1;
 
   display.init();
   display.clear();
@@ -46,31 +51,56 @@ void OLED::initialize() {
 }
 
 /*!
- *  @brief  Update the OLED screen with the current buffer content.
+ *  @brief  Redraws the changed lines of the visible page, at most every OLED_FRAME_INTERVAL ms.
  *
- *  needs to be called periodically as it alters the pages
+ *  needs to be called periodically as it alters the pages, the update methods only change the buffer.
+ *  Only the band of a changed line is cleared and drawn again, the display library sends only the
+ *  changed part of the framebuffer over I2C.
  */
 void OLED::updateScreen() {
+  if (millis() - lastFrame < OLED_FRAME_INTERVAL) {
+    return;
+  }
+  uint8_t pageMask = (1 << MAX_LINES) - 1;
+  // changes of the page shown right now
+  uint8_t redraw = (dirtyLines >> (lineIndex * MAX_LINES)) & pageMask;
+  dirtyLines &= ~((uint16_t)pageMask << (lineIndex * MAX_LINES));
+
   if (millis() - lastPageUpdate > PAGE_DURATION) {
-    dataChanged = true;
-    lineIndex++;
-    if (lineIndex > MAX_PAGES - 1) {
-      lineIndex = 0;
+    uint8_t nextIndex = (lineIndex + 1) % MAX_PAGES;
+    // lines with the same text on both pages stay as they are
+    for (uint8_t i = 0; i < MAX_LINES; i++) {
+      if (strcmp(lines[i + (lineIndex * MAX_LINES)], lines[i + (nextIndex * MAX_LINES)]) != 0) {
+        redraw |= (1 << i);
+      }
     }
+    lineIndex = nextIndex;
+    redraw |= (dirtyLines >> (lineIndex * MAX_LINES)) & pageMask;
+    dirtyLines &= ~((uint16_t)pageMask << (lineIndex * MAX_LINES));
     lastPageUpdate = millis();
   }
-  if (dataChanged) {
-    display.clear();
-    display.drawString(0, 0, lines[0 + (lineIndex * MAX_LINES)]); 
-    display.drawString(0, 13, lines[1 + (lineIndex * MAX_LINES)]);
-    display.drawString(0, 25, lines[2 + (lineIndex * MAX_LINES)]);
-    display.drawString(0, 38, lines[3 + (lineIndex * MAX_LINES)]);
-    display.drawString(0, 51, lines[4 + (lineIndex * MAX_LINES)]);
-
-    // Write the buffer to the display
-    display.display();
-    dataChanged = false;
-  }  
+  if (redraw == 0) {
+    return;
+  }
+  STATS_START(frameStart);
+
+  for (uint8_t i = 0; i < MAX_LINES; i++) {
+    if (redraw & (1 << i)) {
+      display.setColor(BLACK);
+      display.fillRect(0, LINE_Y[i], DISPLAY_WIDTH, LINE_Y[i + 1] - LINE_Y[i]);
+      display.setColor(WHITE);
+      // the line above may reach into the cleared band
+      if (i > 0) {
+        drawLine(i - 1);
+      }
+      drawLine(i);
+    }
+  }
+
+  // Write the buffer to the display
+  display.display();
+  lastFrame = millis();
+  STATS_STOP(OLED_FRAME, frameStart);
 }
 
 /*!
@@ -79,10 +109,11 @@ void OLED::updateScreen() {
  *  @param  ssid  The SSID of the WiFi network.
  */
 void OLED::updateWifiInfo(const char* ip, const char* ssid) {
-  strncpy(lines[1], String(String("SSID: ") + String(ssid)).c_str(), MAX_CHAR_IN_LINE - 1);
-  strncpy(lines[6], String(String("Own IP: ") + String(ip)).c_str(), MAX_CHAR_IN_LINE - 1);
-  dataChanged = true;
-  updateScreen();
+  char text[MAX_CHAR_IN_LINE];
+  snprintf(text, sizeof(text), "SSID: %s", ssid);
+  setLine(1, text);
+  snprintf(text, sizeof(text), "Own IP: %s", ip);
+  setLine(6, text);
 }
 
 /*!
@@ -92,11 +123,12 @@ void OLED::updateWifiInfo(const char* ip, const char* ssid) {
  *  @param  connected  Connection status to the MQTT broker.
  */
 void OLED::updateMqttInfo(const char* ip, const int port, boolean connected) {
-  String status = connected ? "" : "X - ";
-  strncpy(lines[2], String(status + String("Broker: ") + String(ip)).c_str(), MAX_CHAR_IN_LINE - 1);
-  strncpy(lines[7], String(status + String("MQTT port: ") + String(port)).c_str(), MAX_CHAR_IN_LINE - 1);
-  dataChanged = true;
-  updateScreen();
+  char text[MAX_CHAR_IN_LINE];
+  const char* status = connected ? "" : "X - ";
+  snprintf(text, sizeof(text), "%sBroker: %s", status, ip);
+  setLine(2, text);
+  snprintf(text, sizeof(text), "%sMQTT port: %d", status, port);
+  setLine(7, text);
 }
 
 /*!
@@ -106,16 +138,16 @@ void OLED::updateMqttInfo(const char* ip, const int port, boolean connected) {
  *  @param  program  The program to be started, if <>0 zone and time is ignored
  */
 void OLED::updateHunterInfo(const int zone, const int time, const int program) {
-  String message = String(String("Zone: ") + String(zone));
-  String onOffMsg = time ? String(" on for ") + String(time) + String(" min") : String(" off");
-  message = message + String(onOffMsg);
+  char text[MAX_CHAR_IN_LINE];
   if (program != 0) {
-    message = "Prog " + String(program) + " started";
+    snprintf(text, sizeof(text), "Prog %d started", program);
+  } else if (time) {
+    snprintf(text, sizeof(text), "Zone: %d on for %d min", zone, time);
+  } else {
+    snprintf(text, sizeof(text), "Zone: %d off", zone);
   }
-  strncpy(lines[0], message.c_str(), MAX_CHAR_IN_LINE - 1);
-  strncpy(lines[5], lines[0], MAX_CHAR_IN_LINE);
-  dataChanged = true;
-  updateScreen();
+  setLine(0, text);
+  setLine(5, text);
 }
 
 /*!
@@ -125,13 +157,13 @@ void OLED::updateHunterInfo(const int zone, const int time, const int program) {
  */
 void OLED::updateDHT(const float t, const float h) {
   // Round temperature to 1 decimal place
-  char cTemp[6];
+  char cTemp[8];
   dtostrf(t, 4, 1, cTemp);
   int iHumidity = (int)h;
-  strncpy(lines[3], String(String("Temp: ") + String(cTemp) + String(" °C  Hum: ") + String(iHumidity) + String(" %")).c_str(), MAX_CHAR_IN_LINE - 1);
-  strncpy(lines[8], lines[3], MAX_CHAR_IN_LINE);
-  dataChanged = true;
-  updateScreen();
+  char text[MAX_CHAR_IN_LINE];
+  snprintf(text, sizeof(text), "Temp: %s °C  Hum: %d %%", cTemp, iHumidity);
+  setLine(3, text);
+  setLine(8, text);
 }
 
 /*!
@@ -139,8 +171,29 @@ void OLED::updateDHT(const float t, const float h) {
  *  @param  message  The action message.
  */
 void OLED::updateAction(const char* message) {
-  strncpy(lines[4], message, MAX_CHAR_IN_LINE - 1);
-  strncpy(lines[9], lines[4], MAX_CHAR_IN_LINE);  
-  dataChanged = true;
-  updateScreen();
-}
\ No newline at end of file
+  setLine(4, message);
+  setLine(9, message);
+}
+
+// ======= private functions ===================================================
+
+/*!
+ *  @brief  Sets the text of a line, it is marked for the next redraw only if it changed.
+ *  @param  index  Index into lines, 0-4 page 1, 5-9 page 2.
+ *  @param  text   The new text, cut to MAX_CHAR_IN_LINE - 1 characters.
+ */
+void OLED::setLine(const uint8_t index, const char* text) {
+  if (strncmp(lines[index], text, MAX_CHAR_IN_LINE - 1) == 0) {
+    return;
+  }
+  strlcpy(lines[index], text, MAX_CHAR_IN_LINE);
+  dirtyLines |= (1 << index);
+}
+
+/*!
+ *  @brief  Draws a line of the visible page into the framebuffer.
+ *  @param  line  The line on the display, 0-4.
+ */
+void OLED::drawLine(const uint8_t line) {
+  display.drawString(0, LINE_Y[line], lines[line + (lineIndex * MAX_LINES)]);
+}
@@ -53,6 +53,7 @@
 #define MAX_PAGES  2
 #define ARRAY_LEN  (MAX_LINES * MAX_PAGES)
 #define MAX_CHAR_IN_LINE  40
+#define OLED_FRAME_INTERVAL  200   // ms, min time between two redraws, updates in between are coalesced
 // Abstraction is for 5 lines of text as defined below.
 // since some text for lines are to long, 2 pages with a change in PAGE_DURATION ms is supported
   // display.drawString(0, 0, "Zeile by y 0");      water zone x for y min
@@ -76,13 +77,15 @@ public:
   void updateDHT(const float t, const float h);
   void updateAction(const char* message);
   void updateScreen();
-  void displayMessage(const String& message);
 
 private:
+  void          setLine(const uint8_t index, const char* text);
+  void          drawLine(const uint8_t line);
   char          lines[ARRAY_LEN][MAX_CHAR_IN_LINE];  // 0-4 sind die page 1, 5-9 die page 2
   uint8_t       lineIndex = 0;
   long          lastPageUpdate = 0;
-  boolean       dataChanged;
+  long          lastFrame = 0;
+  uint16_t      dirtyLines = 0;   // bit per entry of lines, set if changed since it was drawn
   SSD1306Wire   display;
 };
 
@@ -0,0 +1,88 @@
+/*!
+ *  @file ring_buffer.h
+ *
+ *  This is a fixed-capacity ring buffer without any dynamic memory.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <Arduino.h>
+
+/*!
+ *  @brief  Template class for a FIFO of N elements of type T.
+ *
+ *  N has to be a power of 2, the free running indices are masked on access.
+ *  One producer and one consumer may use it without locking.
+ */
+template <typename T, uint16_t N>
+class RING_BUFFER {
+  static_assert((N > 0) && ((N & (N - 1)) == 0), "RING_BUFFER capacity has to be a power of 2");
+  static_assert(N <= 0x8000, "RING_BUFFER capacity too large for 16 bit indices");
+
+public:
+  // constructor
+  RING_BUFFER() : head(0), tail(0) {};
+
+  /*!
+   *  @brief  Appends an element.
+   *  @param  item  The element to append.
+   *  @return True if stored, false if the buffer is full.
+   */
+  boolean push(const T& item) {
+    if (full()) {
+      return false;
+    }
+    buffer[head & (N - 1)] = item;
+    head = head + 1;
+    return true;
+  }
+
+  /*!
+   *  @brief  Removes the oldest element.
+   *  @param  item  Receives the element.
+   *  @return True if an element was removed, false if the buffer is empty.
+   */
+  boolean pop(T& item) {
+    if (empty()) {
+      return false;
+    }
+    item = buffer[tail & (N - 1)];
+    tail = tail + 1;
+    return true;
+  }
+
+  /*!
+   *  @brief  Gets the oldest element without removing it.
+   *  @return Pointer to the element or nullptr if the buffer is empty.
+   */
+  const T* peek() const {
+    return empty() ? nullptr : &buffer[tail & (N - 1)];
+  }
+
+  /*!
+   *  @brief  Gets an element by its position without removing it.
+   *  @param  index  0 is the oldest element, size() - 1 the newest.
+   *  @return The element, index has to be less than size().
+   */
+  const T& at(const uint16_t index) const {
+    return buffer[(uint16_t)(tail + index) & (N - 1)];
+  }
+
+  void     clear()          { tail = head; }
+  uint16_t size() const     { return (uint16_t)(head - tail); }
+  uint16_t capacity() const { return N; }
+  boolean  empty() const    { return head == tail; }
+  boolean  full() const     { return size() == N; }
+
+private:
+  T                  buffer[N];
+  volatile uint16_t  head;    // next free slot, only changed by the producer
+  volatile uint16_t  tail;    // oldest element, only changed by the consumer
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,132 @@
+/*!
+ *  @file scheduler.cpp
+ *
+ *  @mainpage  cooperative scheduler in a HUNTER XCORE watering application.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  Each subsystem registers a task with its own period. The main loop calls run(),
+ *  which executes the due tasks and sleeps until the next deadline or until a wake
+ *  function signals an event like a received MQTT packet or a completed Hunter frame.
+ *  Sleeping is done with delay(1), which gives the time to the WIFI stack.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "scheduler.h"
+#include "stats.h"
+#include "logger.h"
+
+/*!
+ * @brief registers a task, the first run is right away
+ *
+ * @param func    function to run
+ * @param period  ms between two runs
+ * @param wake    optional function checked while sleeping to run the task early
+ *
+ * @return id of the task or NO_TASK if too many tasks are registered
+ */
+int8_t SCHEDULER::addTask(TASK_FUNC func, const uint32_t period, WAKE_FUNC wake) {
+  if ((count >= MAX_TASKS) || (func == nullptr)) {
+    LOG_ERROR("scheduler task not registered");
+    return NO_TASK;
+  }
+  tasks[count].func = func;
+  tasks[count].wake = wake;
+  tasks[count].period = period;
+  tasks[count].nextRun = millis();
+  return count++;
+}
+
+/*!
+ * @brief moves the deadline of a task forward, a later deadline is ignored
+ *
+ * @param id    id of the task
+ * @param inMs  ms from now, 0 runs the task in the next run()
+ */
+void SCHEDULER::trigger(const int8_t id, const uint32_t inMs) {
+  if ((id < 0) || (id >= count)) {
+    return;
+  }
+  uint32_t deadline = millis() + inMs;
+  if ((int32_t)(deadline - tasks[id].nextRun) < 0) {
+    tasks[id].nextRun = deadline;
+  }
+}
+
+/*!
+ * @brief changes the period of a task, takes effect after its next run
+ *
+ * @param id      id of the task
+ * @param period  ms between two runs
+ */
+void SCHEDULER::setPeriod(const int8_t id, const uint32_t period) {
+  if ((id >= 0) && (id < count)) {
+    tasks[id].period = period;
+  }
+}
+
+/*!
+ * @brief runs all due tasks and sleeps until the next deadline
+ *
+ * shall be called from the main loop
+ */
+void SCHEDULER::run() {
+  STATS_START(runStart);
+  STATS_ONLY(boolean ran = false;)
+  for (byte i = 0; i < count; i++) {
+    uint32_t now = millis();
+    if ((int32_t)(now - tasks[i].nextRun) >= 0) {
+      tasks[i].nextRun += tasks[i].period;
+      if ((int32_t)(now - tasks[i].nextRun) >= 0) {
+        // task is late by more than a period, do not catch up
+        tasks[i].nextRun = now + tasks[i].period;
+      }
+      tasks[i].func();
+      STATS_ONLY(ran = true;)
+    }
+  }
+  STATS_ONLY(if (ran) { STATS_STOP(LOOP, runStart); })
+  sleepUntil(nextDeadline());
+}
+
+// ======= private functions ===================================================
+
+/*!
+ * @brief finds the earliest deadline of all tasks
+ *
+ * @return millis() of the next deadline
+ */
+uint32_t SCHEDULER::nextDeadline() const {
+  uint32_t now = millis();
+  uint32_t deadline = now + 1000;   // wake up at least once a second
+  for (byte i = 0; i < count; i++) {
+    if ((int32_t)(tasks[i].nextRun - deadline) < 0) {
+      deadline = tasks[i].nextRun;
+    }
+  }
+  return deadline;
+}
+
+/*!
+ * @brief sleeps until the deadline or until a wake function signals work
+ *
+ * @param deadline  millis() to wake up
+ */
+void SCHEDULER::sleepUntil(const uint32_t deadline) {
+  while ((int32_t)(deadline - millis()) > 0) {
+    for (byte i = 0; i < count; i++) {
+      if (tasks[i].wake && tasks[i].wake()) {
+        tasks[i].nextRun = millis();
+        return;
+      }
+    }
+    delay(1);
+  }
+}
@@ -0,0 +1,61 @@
+/*!
+ *  @file scheduler.h
+ *
+ *  This is a small cooperative scheduler for the main loop.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define MAX_TASKS     16
+#define NO_TASK       -1
+
+/*!
+ *  @brief  Function run by a task.
+ */
+typedef void (*TASK_FUNC)();
+
+/*!
+ *  @brief  Function checked while sleeping, returns true if the task has work to do now.
+ */
+typedef boolean (*WAKE_FUNC)();
+
+/*!
+ *  @brief  Class that runs registered tasks by period or deadline.
+ *
+ *  run() executes all due tasks and then sleeps until the next deadline.
+ *  While sleeping, the wake functions of the tasks are checked every millisecond,
+ *  a task whose wake function returns true is run right away.
+ */
+class SCHEDULER {
+public:
+  // constructor
+  SCHEDULER() : count(0) {};
+  // public methods
+  int8_t  addTask(TASK_FUNC func, const uint32_t period, WAKE_FUNC wake = nullptr);
+  void    trigger(const int8_t id, const uint32_t inMs = 0);
+  void    setPeriod(const int8_t id, const uint32_t period);
+  void    run();
+
+private:
+  typedef struct {
+    TASK_FUNC func;
+    WAKE_FUNC wake;
+    uint32_t  period;     // ms between two runs
+    uint32_t  nextRun;    // millis() of the next deadline
+  } TASK;
+
+  TASK      tasks[MAX_TASKS];
+  byte      count;
+
+  uint32_t  nextDeadline() const;
+  void      sleepUntil(const uint32_t deadline);
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,128 @@
+/*!
+ *  @file stats.cpp
+ *
+ *  @mainpage  run time statistics of the application.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  The hot paths record their durations and events with the STATS_* macros, which compile out
+ *  completely if USE_STATS is false. Every STATS_INTERVAL ms count, average and max of each
+ *  duration since the last message, the event counters since start and the heap are published
+ *  on PRE_MQTT/stats, durations are reset afterwards.
+ *    {
+ *      "uptime": 3600,                       // s since start
+ *      "heap": [<free>, <min free>, <largest block>],
+ *      "json": [<peak>, <capacity>],        // bytes of the config arena
+ *      "log_dropped": 0,                     // log messages lost in a full ring since start
+ *      "log_mirror_dropped": 0,              // log messages not mirrored, e.g. while the broker was down
+ *      "loop_us": [<count>, <avg>, <max>],   // one array per STATS_TIMER
+ *      ...
+ *      "mqtt_connects": 1,                   // one value per STATS_COUNTER
+ *      ...
+ *    }
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "stats.h"
+
+#if USE_STATS
+
+#include "mqtt.h"
+#include "logger.h"
+
+// member names, in order of STATS_TIMER and STATS_COUNTER
+static const char* const TIMER_NAMES[(byte)STATS_TIMER::COUNT] = {
+  "loop_us", "tx_us", "jitter_us", "latency_us", "mqtt_connect_us", "mqtt_down_ms", "wifi_down_ms", "eeprom_us", "oled_us" };
+static const char* const COUNTER_NAMES[(byte)STATS_COUNTER::COUNT] = {
+  "mqtt_connects", "mqtt_fails", "wifi_connects", "wifi_fallbacks" };
+
+STATS appStats;
+
+/*!
+ * @brief initalizes the STATS class
+ *
+ * @param mqtt  pointer to MQTT class used to publish the statistics
+ */
+void STATS::initialize(MQTT* mqtt) {
+  this->mqtt = mqtt;
+  lastPublish = millis();
+}
+
+/*!
+ * @brief records a measured duration
+ *
+ * @param timer     the measured duration
+ * @param duration  value in the unit of the timer
+ */
+void STATS::record(const STATS_TIMER timer, const uint32_t duration) {
+  STATS_TIMING& timing = timings[(byte)timer];
+  timing.count++;
+  timing.sum += duration;
+  if (duration > timing.max) {
+    timing.max = duration;
+  }
+}
+
+/*!
+ * @brief loop called periodically, observes the heap and publishes when due
+ */
+void STATS::loop() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < minFreeHeap) {
+    minFreeHeap = freeHeap;
+  }
+  if (!mqtt || (mqtt->getState() != MQTT_STATE::BROKER_CONNECTED) || (millis() - lastPublish < interval)) {
+    return;
+  }
+  if (publish()) {
+    memset(timings, 0, sizeof(timings));
+    minFreeHeap = freeHeap;
+  }
+  lastPublish = millis();
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief publishes all statistics as one message
+ *
+ * @return success or failure, the durations are kept for the next message on failure
+ */
+boolean STATS::publish() {
+  JSON_WRITER json = mqtt->payloadWriter();
+  json.beginObject()
+        .add("uptime", (int)(millis() / 1000))
+        .beginArray("heap")
+          .value((int)ESP.getFreeHeap())
+          .value((int)minFreeHeap)
+          .value((int)ESP.getMaxFreeBlockSize())
+        .endArray()
+        .beginArray("json")
+          .value((int)MQTT::getArenaPeak())
+          .value((int)MQTT::getArenaCapacity())
+        .endArray()
+        .add("log_dropped", (int)appLog.getDropped())
+        .add("log_mirror_dropped", (int)appLog.getMirrorDropped());
+  for (byte i = 0; i < (byte)STATS_TIMER::COUNT; i++) {
+    json.beginArray(TIMER_NAMES[i])
+          .value((int)timings[i].count)
+          .value((int)(timings[i].count ? timings[i].sum / timings[i].count : 0))
+          .value((int)timings[i].max)
+        .endArray();
+  }
+  for (byte i = 0; i < (byte)STATS_COUNTER::COUNT; i++) {
+    json.add(COUNTER_NAMES[i], (int)counters[i]);
+  }
+  json.endObject();
+
+  return mqtt->publish(MQTT_TOPIC::STATS, json);
+}
+
+#endif // USE_STATS
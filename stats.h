@@ -0,0 +1,99 @@
+/*!
+ *  @file stats.h
+ *
+ *  This is a class collecting run time statistics of the application.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <Arduino.h>
+
+#define USE_STATS        true     // set false to compile out all instrumentation
+#define STATS_INTERVAL   60000    // ms between two messages on PRE_MQTT/stats
+
+/*!
+ *  @brief  Enum class for the measured durations, index into the timings.
+ */
+enum class STATS_TIMER : byte {
+  LOOP          = 0,    // us, scheduler run with at least one task
+  HUNTER_FRAME  = 1,    // us, send() until the last edge of a frame
+  HUNTER_JITTER = 2,    // us, max lateness of an edge within a frame
+  CMD_LATENCY   = 3,    // us, command received until its frame starts on the bus
+  MQTT_CONNECT  = 4,    // us, one blocking connection attempt
+  MQTT_DOWN     = 5,    // ms, broker connection lost until connected again
+  WIFI_DOWN     = 6,    // ms, WIFI lost until connected again
+  EEPROM_COMMIT = 7,    // us, flash commit
+  OLED_FRAME    = 8,    // us, redraw incl. I2C transfer
+  COUNT
+};
+
+/*!
+ *  @brief  Enum class for the event counters, index into the counters.
+ */
+enum class STATS_COUNTER : byte {
+  MQTT_CONNECTS   = 0,
+  MQTT_FAILS      = 1,
+  WIFI_CONNECTS   = 2,
+  WIFI_FALLBACKS  = 3,  // fast reconnects falling back to a full connect
+  COUNT
+};
+
+/*!
+ *  @brief  Struct for the durations measured since the last message.
+ */
+typedef struct {
+  uint32_t  count;
+  uint32_t  sum;
+  uint32_t  max;
+} STATS_TIMING;
+
+#if USE_STATS
+
+class MQTT;
+
+class STATS {
+public:
+  // constructor
+  STATS() : mqtt(nullptr), interval(STATS_INTERVAL), lastPublish(0), minFreeHeap(0xffffffff), timings{}, counters{} {};
+  // public methods
+  void    initialize(MQTT* mqtt);
+  void    record(const STATS_TIMER timer, const uint32_t duration);
+  void    count(const STATS_COUNTER counter) { counters[(byte)counter]++; }
+  void    setInterval(const uint32_t interval) { this->interval = interval; }
+  void    loop();
+
+private:
+  boolean publish();
+  MQTT*         mqtt;
+  uint32_t      interval;
+  uint32_t      lastPublish;    // millis() of the last message
+  uint32_t      minFreeHeap;    // since the last message
+  STATS_TIMING  timings[(byte)STATS_TIMER::COUNT];
+  uint32_t      counters[(byte)STATS_COUNTER::COUNT];   // since start
+};
+
+extern STATS appStats;
+
+// instrumentation, expands to nothing if USE_STATS is false
+#define STATS_ONLY(code)            code
+#define STATS_START(var)            uint32_t var = micros()
+#define STATS_STOP(timer, var)      appStats.record(STATS_TIMER::timer, micros() - (var))
+#define STATS_RECORD(timer, value)  appStats.record(STATS_TIMER::timer, (value))
+#define STATS_COUNT(counter)        appStats.count(STATS_COUNTER::counter)
+
+#else
+
+#define STATS_ONLY(code)
+#define STATS_START(var)
+#define STATS_STOP(timer, var)
+#define STATS_RECORD(timer, value)
+#define STATS_COUNT(counter)
+
+#endif // USE_STATS
+
+#endif // STATS_H
@@ -0,0 +1,252 @@
+/*!
+ *  @file telemetry.cpp
+ *
+ *  @mainpage  coalescing publisher for the value topic.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  The subsystems hand their values over to this class instead of publishing them one by one.
+ *  Changed fields are marked dirty and merged into one "value" message, which is sent at most
+ *  every TELEMETRY_MIN_INTERVAL ms. Priority fields, e.g. a started zone, are sent right away
+ *  together with everything else dirty at that time. After each broker connection the WIFI and
+ *  broker fields are sent as before.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "telemetry.h"
+#include "fixed_string.h"
+#include "logger.h"
+
+/*!
+ * @brief initalizes the TELEMETRY class
+ *
+ * @param mqtt      pointer to MQTT class used to publish the messages
+ * @param appData   pointer to APP_DATA class, storing shared data used in the application
+ */
+void TELEMETRY::initialize(MQTT* mqtt, APP_DATA* appData) {
+  this->mqtt = mqtt;
+  this->appData = appData;
+  dirty = 0;
+  hunterDirty = 0;
+  urgent = false;
+  connected = false;
+}
+
+/*!
+ * @brief sets the working WIFI parameter
+ *
+ * @param ssid WIFI SSID
+ * @param ip   WIFI DHCP IP address
+ */
+void TELEMETRY::setWifi(const char* ssid, const char* ip) {
+  strlcpy(wifiSsid, ssid ? ssid : "", sizeof(wifiSsid));
+  strlcpy(wifiIp, ip ? ip : "", sizeof(wifiIp));
+  mark(TELEMETRY_FIELD::TM_WIFI);
+}
+
+/*!
+ * @brief sets the working MQTT parameter
+ *
+ * @param ip   MQTT broker IP address
+ * @param port MQTT broker port
+ */
+void TELEMETRY::setBroker(const char* ip, const int port) {
+  strlcpy(brokerIp, ip ? ip : "", sizeof(brokerIp));
+  brokerPort = port;
+  mark(TELEMETRY_FIELD::TM_BROKER);
+}
+
+/*!
+ * @brief sets the temperature and humidity values from DHT sensor
+ *
+ * @param temp      temperatur
+ * @param humidity  humidity
+ */
+void TELEMETRY::setDht(const float temp, const float humidity) {
+  this->temp = temp;
+  this->humidity = humidity;
+  mark(TELEMETRY_FIELD::TM_DHT);
+}
+
+/*!
+ * @brief sets the parameter used to adjust the DHT sensor
+ *
+ * @param temp_level   level of temperatur change triggering a value update to broker
+ * @param hum_level    level of humidity change triggering a value update to broker
+ * @param temp_offset  the offset to the measured temperatur
+ */
+void TELEMETRY::setDhtParams(const float temp_level, const int hum_level, const int temp_offset) {
+  tempLevel = temp_level;
+  humLevel = hum_level;
+  tempOffset = temp_offset;
+  mark(TELEMETRY_FIELD::TM_DHT_PARAMS);
+}
+
+/*!
+ * @brief sets the last watering command sent to the Hunter bus of its controller
+ *
+ * every controller keeps its own values, a change of one does not overwrite the others
+ *
+ * @param cmd      the command
+ * @param queued   number of commands still waiting for the bus of the controller
+ * @param skipped  number of redundant commands of the controller acknowledged without a frame
+ */
+void TELEMETRY::setHunter(const HUNTER_CMD& cmd, const uint16_t queued, const uint16_t skipped) {
+  if (cmd.controller >= HUNTER_CONTROLLERS) {
+    return;
+  }
+  hunterCmd[cmd.controller] = cmd;
+  hunterQueued[cmd.controller] = queued;
+  hunterSkipped[cmd.controller] = skipped;
+  hunterDirty |= (1 << cmd.controller);
+  mark(TELEMETRY_FIELD::TM_HUNTER);
+}
+
+/*!
+ * @brief checks if a message is to be sent, cheap enough to be polled
+ *
+ * @return true if fields are dirty, the broker is connected and a priority field or the interval is due
+ */
+boolean TELEMETRY::flushDue() const {
+  if (!dirty || !mqtt || (mqtt->getState() != MQTT_STATE::BROKER_CONNECTED)) {
+    return false;
+  }
+  return urgent || ((millis() - lastFlush) >= minInterval);
+}
+
+/*!
+ * @brief loop called periodically, sends the value message when it is due
+ *
+ * a new broker session marks the WIFI and broker fields and sends them right away, a resumed one only a changed WIFI lease
+ */
+void TELEMETRY::loop() {
+  if (!mqtt) {
+    return;
+  }
+  boolean isConnected = (mqtt->getState() == MQTT_STATE::BROKER_CONNECTED);
+  if (isConnected && !connected && appData) {
+    // WIFI and MQTT parameter are working, publish them with the first message of a session,
+    // a resumed session only publishes a changed WIFI lease
+    IP_STRING ip = ipString(appData->getWifiIp());
+    if (!mqtt->isResumed() || (strcmp(wifiIp, ip.c_str()) != 0) || (strcmp(wifiSsid, appData->getWifiSsid()) != 0)) {
+      setWifi(appData->getWifiSsid(), ip.c_str());
+      urgent = true;
+    }
+    if (!mqtt->isResumed()) {
+      setBroker(ipString(appData->getMqttIp()).c_str(), appData->getMqttPort());
+    }
+  }
+  connected = isConnected;
+
+  if (flushDue()) {
+    flush();
+  }
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief marks a field as changed
+ *
+ * @param field  the field
+ */
+void TELEMETRY::mark(const TELEMETRY_FIELD field) {
+  dirty |= (byte)field;
+  if (priority & (byte)field) {
+    urgent = true;
+  }
+}
+
+/*!
+ * @brief publishes all dirty fields as one value message
+ *
+ * the fields stay dirty if publishing fails, they are sent again after the interval
+ *
+ * @return success or failure
+ */
+boolean TELEMETRY::flush() {
+  JSON_WRITER json = mqtt->payloadWriter();
+  json.beginObject();
+  if (isDirty(TELEMETRY_FIELD::TM_WIFI)) {
+    json.beginObject("wifi")
+          .add("ssid", wifiSsid)
+          .add("ip", wifiIp)
+        .endObject();
+  }
+  if (isDirty(TELEMETRY_FIELD::TM_BROKER)) {
+    json.beginObject("broker")
+          .add("ip", brokerIp)
+          .add("port", brokerPort)
+        .endObject();
+  }
+  if (isDirty(TELEMETRY_FIELD::TM_DHT) || isDirty(TELEMETRY_FIELD::TM_DHT_PARAMS)) {
+    json.beginObject("dht");
+    if (isDirty(TELEMETRY_FIELD::TM_DHT)) {
+      json.add("temp", temp, 1)
+          .add("humidity", humidity, 1);
+    }
+    if (isDirty(TELEMETRY_FIELD::TM_DHT_PARAMS)) {
+      json.add("temp_offset", tempOffset)
+          .add("temp_level", tempLevel, 2)
+          .add("hum_level", humLevel);
+    }
+    json.endObject();
+  }
+  if (isDirty(TELEMETRY_FIELD::TM_HUNTER)) {
+#if HUNTER_CONTROLLERS > 1
+    // one element per changed controller
+    json.beginArray("hunter");
+    for (byte i = 0; i < HUNTER_CONTROLLERS; i++) {
+      if (hunterDirty & (1 << i)) {
+        addHunter(json, i);
+      }
+    }
+    json.endArray();
+#else
+    addHunter(json, 0);
+#endif
+  }
+  json.endObject();
+
+  lastFlush = millis();
+  urgent = false;
+  LOG_DEBUG("Publishing values");
+  if (!mqtt->publish(MQTT_TOPIC::VALUE, json)) {
+    return false;
+  }
+  dirty = 0;
+  hunterDirty = 0;
+  return true;
+}
+
+/*!
+ * @brief writes the hunter object of a controller
+ *
+ * @param json        writer of the value message
+ * @param controller  index of the controller
+ */
+void TELEMETRY::addHunter(JSON_WRITER& json, const byte controller) const {
+  const HUNTER_CMD& cmd = hunterCmd[controller];
+#if HUNTER_CONTROLLERS > 1
+  json.beginObject()
+      .add("controller", (int)controller + 1);
+#else
+  json.beginObject("hunter");
+#endif
+  if (cmd.type == HUNTER_CMD_TYPE::PROGRAM) {
+    json.add("program", (int)cmd.program);
+  } else {
+    json.add("zone", (int)cmd.zone)
+        .add("time", (int)cmd.time);
+  }
+  json.add("queued", (int)hunterQueued[controller])
+      .add("skipped", (int)hunterSkipped[controller])
+      .endObject();
+}
@@ -0,0 +1,84 @@
+/*!
+ *  @file telemetry.h
+ *
+ *  This is a class collecting all published values into one message.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "app_data.h"
+#include "mqtt.h"
+
+#define TELEMETRY_MIN_INTERVAL  5000    // ms, min time between two value messages without priority fields
+#define TELEMETRY_SSID_LEN      33
+#define TELEMETRY_IP_LEN        16
+
+/*!
+ *  @brief  Enum class for the fields of the value message, can be combined as bit mask.
+ */
+enum class TELEMETRY_FIELD : byte {
+  TM_NONE         = 0x00,
+  TM_WIFI         = 0x01, // 00000001
+  TM_BROKER       = 0x02, // 00000010
+  TM_DHT          = 0x04, // 00000100
+  TM_DHT_PARAMS   = 0x08, // 00001000
+  TM_HUNTER       = 0x10, // 00010000
+};
+
+// fields sent right away, the others wait for TELEMETRY_MIN_INTERVAL
+#define TELEMETRY_PRIORITY  ((byte)TELEMETRY_FIELD::TM_HUNTER | (byte)TELEMETRY_FIELD::TM_DHT_PARAMS)
+
+class TELEMETRY {
+public:
+  // constructor
+  TELEMETRY() : mqtt(nullptr), appData(nullptr), dirty(0), priority(TELEMETRY_PRIORITY), urgent(false),
+                connected(false), minInterval(TELEMETRY_MIN_INTERVAL), lastFlush(0), hunterDirty(0) {};
+  // public methods
+  void    initialize(MQTT* mqtt, APP_DATA* appData);
+  void    setWifi(const char* ssid, const char* ip);
+  void    setBroker(const char* ip, const int port);
+  void    setDht(const float temp, const float humidity);
+  void    setDhtParams(const float temp_level, const int hum_level, const int temp_offset);
+  void    setHunter(const HUNTER_CMD& cmd, const uint16_t queued, const uint16_t skipped);
+  void    setMinInterval(const uint32_t interval) { minInterval = interval; }
+  void    setPriority(const byte fields) { priority = fields; }
+  boolean flushDue() const;
+  void    loop();
+
+private:
+  void    mark(const TELEMETRY_FIELD field);
+  boolean isDirty(const TELEMETRY_FIELD field) const { return dirty & (byte)field; }
+  boolean flush();
+  void    addHunter(JSON_WRITER& json, const byte controller) const;
+  MQTT*     mqtt;
+  APP_DATA* appData;
+  byte      dirty;        // bit mask of TELEMETRY_FIELD changed since the last message
+  byte      priority;     // bit mask of TELEMETRY_FIELD sent right away
+  boolean   urgent;       // a priority field is dirty
+  boolean   connected;    // broker state seen by the last loop()
+  uint32_t  minInterval;
+  uint32_t  lastFlush;    // millis() of the last message
+  // last values of all fields
+  char        wifiSsid[TELEMETRY_SSID_LEN];
+  char        wifiIp[TELEMETRY_IP_LEN];
+  char        brokerIp[TELEMETRY_IP_LEN];
+  int         brokerPort;
+  float       temp;
+  float       humidity;
+  float       tempLevel;
+  int         humLevel;
+  int         tempOffset;
+  // last command of each controller, bit per controller changed since the last message
+  HUNTER_CMD  hunterCmd[HUNTER_CONTROLLERS];
+  uint16_t    hunterQueued[HUNTER_CONTROLLERS];
+  uint16_t    hunterSkipped[HUNTER_CONTROLLERS];
+  byte        hunterDirty;
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,172 @@
+/*!
+ *  @file udp_cmd.cpp
+ *
+ *  @mainpage  UDP listener for watering commands on the LAN.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  A command via the broker takes a round trip to it and fails while it is down. A controller on the
+ *  same LAN sends its commands as UDP datagrams to UDP_PORT instead:
+ *    <counter, 4 bytes big endian> <JSON config message or binary command records> <tag, 16 bytes>
+ *  The tag is the HMAC-SHA256 of counter and message with the shared key, truncated to UDP_TAG_LEN.
+ *  The counter has to increase with every datagram, a datagram not above the last accepted counter is a
+ *  replay. The counter is kept in RTC memory and in EEPROM, a reset does not open the door to replays.
+ *  The message is handed to the same handlers as the MQTT messages and answered with
+ *    {"ok":<message taken by the handler>,"counter":<counter>,"queued":<commands waiting>}
+ *  The listener does not start as long as the shipped key UDP_KEY_PLACEHOLDER is set.
+ *  The listener is polled by the scheduler every millisecond, a zone command reaches the bus right away.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "udp_cmd.h"
+#include "ESP8266WiFi.h"
+#include "fixed_string.h"
+#include "logger.h"
+
+// shared key of the senders, see README
+const char* UDP_key = UDP_KEY_PLACEHOLDER;
+
+/*!
+ * @brief initalizes the UDP_CMD class
+ *
+ * @param appData   pointer to APP_DATA class, storing shared data used in the application
+ */
+void UDP_CMD::initialize(APP_DATA* appData) {
+  this->appData = appData;
+  keyValid = UDP_key && UDP_key[0] && (strcmp(UDP_key, UDP_KEY_PLACEHOLDER) != 0);
+  if (!keyValid) {
+    LOG_ERROR("UDP_key not set, UDP commands disabled");
+    return;
+  }
+  br_hmac_key_init(&key, &br_sha256_vtable, UDP_key, strlen(UDP_key));
+}
+
+/*!
+ * @brief loop called periodically, listens while WIFI is up and handles the received datagrams
+ */
+void UDP_CMD::loop() {
+  if (!WiFi.isConnected()) {
+    if (listening) {
+      udp.stop();
+      listening = false;
+      packetSize = 0;
+    }
+    return;
+  }
+  if (!listening && keyValid) {
+    listening = udp.begin(UDP_PORT);
+    if (listening) {
+      LOG_INFO("UDP commands on port %u", UDP_PORT);
+    }
+  }
+  while (dataAvailable()) {
+    handlePacket();
+    packetSize = 0;
+  }
+}
+
+/*!
+ * @brief checks for a received datagram without handling it, cheap enough to be polled
+ *
+ * @return true if a datagram is waiting to be handled by loop()
+ */
+boolean UDP_CMD::dataAvailable() {
+  if (listening && (packetSize <= 0)) {
+    packetSize = udp.parsePacket();
+  }
+  return listening && (packetSize > 0);
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief reads the selected datagram, authenticates it and hands the message to the command handlers
+ */
+void UDP_CMD::handlePacket() {
+  if ((packetSize > UDP_BUFFER) || (packetSize <= UDP_COUNTER_LEN + UDP_TAG_LEN)) {
+    LOG_WARN("UDP datagram of %d bytes dropped", packetSize);
+    rejected++;
+    return;
+  }
+  int length = udp.read(packet, packetSize);
+  if ((length != packetSize) || !authenticate(packet, length)) {
+    rejected++;
+    return;
+  }
+  // the counter does not wrap around, the sender has to change the key before it runs out
+  uint32_t counter = ((uint32_t)packet[0] << 24) | ((uint32_t)packet[1] << 16) | ((uint32_t)packet[2] << 8) | packet[3];
+  if (counter <= appData->getUdpCounter()) {
+    LOG_WARN("UDP counter %lu not above %lu, replay dropped", (unsigned long)counter, (unsigned long)appData->getUdpCounter());
+    rejected++;
+    return;
+  }
+  if (!appData->setUdpCounter(counter)) {
+    LOG_ERROR("UDP counter reserve not stored, datagram dropped");
+    rejected++;
+    return;
+  }
+  accepted++;
+
+  const byte* message = packet + UDP_COUNTER_LEN;
+  unsigned int messageLength = length - UDP_COUNTER_LEN - UDP_TAG_LEN;
+  boolean ok;
+  if (message[0] == '{') {
+    ok = handleConfigMessage(message, messageLength, CMD_SOURCE::SRC_UDP);
+  } else {
+    ok = handleCmdMessage(message, messageLength, CMD_SOURCE::SRC_UDP);
+  }
+
+  char buffer[UDP_REPLY_LEN];
+  JSON_WRITER json(buffer, sizeof(buffer));
+  json.beginObject()
+        .add("ok", ok)
+        .add("counter", counter)
+        .add("queued", (int)appData->getHunterCmdCount())
+      .endObject();
+  reply(json);
+}
+
+/*!
+ * @brief checks the tag of a datagram in constant time
+ *
+ * @param packet  the datagram
+ * @param length  length of the datagram incl. counter and tag
+ *
+ * @return true if the tag matches the shared key
+ */
+boolean UDP_CMD::authenticate(const byte* packet, const int length) {
+  br_hmac_context ctx;
+  byte tag[32];
+  br_hmac_init(&ctx, &key, UDP_TAG_LEN);
+  br_hmac_update(&ctx, packet, length - UDP_TAG_LEN);
+  br_hmac_out(&ctx, tag);
+  byte diff = 0;
+  for (byte i = 0; i < UDP_TAG_LEN; i++) {
+    diff |= tag[i] ^ packet[length - UDP_TAG_LEN + i];
+  }
+  if (diff) {
+    LOG_WARN("UDP datagram from %s not authenticated", ipString(udp.remoteIP()).c_str());
+  }
+  return diff == 0;
+}
+
+/*!
+ * @brief answers the sender of the current datagram
+ *
+ * @param json  writer holding the reply
+ */
+void UDP_CMD::reply(const JSON_WRITER& json) {
+  if (json.overflowed()) {
+    return;
+  }
+  udp.beginPacket(udp.remoteIP(), udp.remotePort());
+  udp.write((const uint8_t*)json.c_str(), json.length());
+  udp.endPacket();
+}
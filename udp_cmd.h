@@ -0,0 +1,63 @@
+/*!
+ *  @file udp_cmd.h
+ *
+ *  This is a listener for authenticated watering commands on the LAN, independent of the broker.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef UDP_CMD_H
+#define UDP_CMD_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <bearssl/bearssl_hmac.h>
+#include "app_data.h"
+#include "mqtt.h"
+
+#define USE_UDP           false     // set true to accept commands on UDP_PORT
+#define UDP_PORT          4210      // local port of the listener
+#define UDP_BUFFER        MQTT_PUBLISH_BUFFER   // max datagram, a JSON message has to fit into the config arena
+#define UDP_COUNTER_LEN   4         // big endian counter in front of the message, one counter for all senders of the key
+#define UDP_TAG_LEN       16        // truncated HMAC-SHA256 of counter and message behind the message
+#define UDP_REPLY_LEN     64
+#define UDP_KEY_PLACEHOLDER "REPLACE_WITH_UDP_KEY"  // shipped key, the listener does not start with it
+
+/*!
+ *  @brief  Class that takes JSON and binary commands from UDP datagrams and feeds them to the command queue.
+ *
+ *  A datagram is <counter><message><tag>, the message is a JSON config message or binary command records
+ *  as on the MQTT topics. The tag authenticates it with the shared key, a counter not above the last accepted
+ *  one is a replay. There is a single counter, not one per sender, senders sharing the key have to take their
+ *  counters from a common source. The last counter is kept by appData over resets and power cycles. Accepted datagrams are
+ *  answered to the sender with the result of the handler, others are dropped silently.
+ */
+class UDP_CMD {
+public:
+  // constructor
+  UDP_CMD() : appData(nullptr), keyValid(false), listening(false), packetSize(0), accepted(0), rejected(0) {};
+  // public methods
+  void    initialize(APP_DATA* appData);
+  void    loop();
+  boolean dataAvailable();
+  uint32_t getAccepted() const { return accepted; }
+  uint32_t getRejected() const { return rejected; }
+
+private:
+  void    handlePacket();
+  boolean authenticate(const byte* packet, const int length);
+  void    reply(const JSON_WRITER& json);
+  APP_DATA* appData;
+  WiFiUDP   udp;
+  br_hmac_key_context key;
+  boolean   keyValid;         // a key other than UDP_KEY_PLACEHOLDER is set, the listener starts only with it
+  boolean   listening;
+  int       packetSize;       // size of the datagram selected by parsePacket(), 0 if none
+  uint32_t  accepted;         // datagrams handed to the command handlers since start
+  uint32_t  rejected;         // datagrams dropped since start
+  byte      packet[UDP_BUFFER];
+};
+
+#endif // UDP_CMD_H
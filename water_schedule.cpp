@@ -0,0 +1,210 @@
+/*!
+ *  @file water_schedule.cpp
+ *
+ *  @mainpage  local watering schedule with a timer wheel.
+ *
+ *  @section intro_sec Introduction
+ *
+ *  The entries of the schedule are stored in APP_DATA and run weekly at a local time, they are
+ *  configured on PRE_MQTT/config. Their commands go into the same queue as the MQTT commands.
+ *  Pending events are kept in a hashed timer wheel with one slot per minute
+ *    - slot = minute since epoch & (SCHEDULE_WHEEL_SLOTS - 1)
+ *    - an event further away than one turn stays in its slot until its minute comes up
+ *    - stop events of a minute are handled before the start events, so a run ends before the next one starts
+ *  The wheel is rebuilt when the entries change, the time is set the first time, it jumps or
+ *  the daylight saving time switches.
+ *
+ *  @section author Author
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  @section license License
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#include "water_schedule.h"
+#include "logger.h"
+
+/*!
+ * @brief initalizes the WATER_SCHEDULE class and starts SNTP with the time zone of the entries
+ *
+ * @param appData  pointer to APP_DATA class holding the entries and the command queue
+ */
+void WATER_SCHEDULE::initialize(APP_DATA* appData) {
+  this->appData = appData;
+  // SNTP runs in the background as soon as WIFI is up
+  configTime(SCHEDULE_TZ, SCHEDULE_NTP_SERVER);
+  memset(wheel, NO_EVENT, sizeof(wheel));
+  freeList = NO_EVENT;
+  for (byte i = 0; i < SCHEDULE_EVENTS; i++) {
+    events[i].next = freeList;
+    freeList = i;
+  }
+  lastMinute = 0;
+}
+
+/*!
+ * @brief loop called periodically, ticks the wheel once per minute
+ */
+void WATER_SCHEDULE::loop() {
+  if (!appData) {
+    return;
+  }
+  time_t now = time(nullptr);
+  if (now < SCHEDULE_TIME_VALID) {
+    return;
+  }
+  uint32_t minute = now / 60;
+  if ((minute == lastMinute) && (version == appData->getScheduleVersion())) {
+    return;
+  }
+  struct tm local;
+  localtime_r(&now, &local);
+  if (!lastMinute || (version != appData->getScheduleVersion()) || (local.tm_isdst != isDst)
+      || (minute < lastMinute) || (minute - lastMinute > SCHEDULE_WHEEL_SLOTS)) {
+    rebuild(minute, local);
+    return;
+  }
+  // catch up with minutes missed by a long task
+  while (lastMinute != minute) {
+    lastMinute++;
+    tick(lastMinute, minute, local);
+  }
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief drops all start events and schedules the next run of every entry, pending zone stops are kept
+ *
+ * @param minute  minutes since epoch
+ * @param local   local time of minute
+ */
+void WATER_SCHEDULE::rebuild(const uint32_t minute, const struct tm& local) {
+  for (byte slot = 0; slot < SCHEDULE_WHEEL_SLOTS; slot++) {
+    byte* link = &wheel[slot];
+    while (*link != NO_EVENT) {
+      byte i = *link;
+      if ((events[i].type == SCHEDULE_EVENT_TYPE::EV_START) || (events[i].minute <= minute)) {
+        *link = events[i].next;
+        if (events[i].type == SCHEDULE_EVENT_TYPE::EV_STOP) {
+          // the time jumped over the end of a run
+          fire(events[i], minute, minute, local);
+        }
+        events[i].next = freeList;
+        freeList = i;
+      } else {
+        link = &events[i].next;
+      }
+    }
+  }
+  for (byte entry = 0; entry < SCHEDULE_MAX; entry++) {
+    scheduleNext(entry, minute, local);
+  }
+  lastMinute = minute;
+  version = appData->getScheduleVersion();
+  isDst = local.tm_isdst;
+  LOG_INFO("Schedule rebuilt");
+}
+
+/*!
+ * @brief handles the events due in a minute, stop events first
+ *
+ * @param minute  minutes since epoch of the tick
+ * @param now     minutes since epoch of local, later than minute while catching up
+ * @param local   local time of the current minute
+ */
+void WATER_SCHEDULE::tick(const uint32_t minute, const uint32_t now, const struct tm& local) {
+  byte* slot = &wheel[minute & (SCHEDULE_WHEEL_SLOTS - 1)];
+  for (byte pass = 0; pass < 2; pass++) {
+    SCHEDULE_EVENT_TYPE type = pass ? SCHEDULE_EVENT_TYPE::EV_START : SCHEDULE_EVENT_TYPE::EV_STOP;
+    byte* link = slot;
+    while (*link != NO_EVENT) {
+      byte i = *link;
+      if ((events[i].minute == minute) && (events[i].type == type)) {
+        // the event is freed first, firing may add new events
+        SCHEDULE_EVENT event = events[i];
+        *link = events[i].next;
+        events[i].next = freeList;
+        freeList = i;
+        fire(event, minute, now, local);
+      } else {
+        link = &events[i].next;
+      }
+    }
+  }
+}
+
+/*!
+ * @brief queues the command of an event, a start schedules the zone stop and the next run
+ *
+ * @param event   the due event, already removed from the wheel
+ * @param minute  minutes since epoch the event was due
+ * @param now     minutes since epoch of local
+ * @param local   local time of the current minute
+ */
+void WATER_SCHEDULE::fire(const SCHEDULE_EVENT& event, const uint32_t minute, const uint32_t now, const struct tm& local) {
+  const SCHEDULE_ENTRY& entry = appData->getScheduleEntry(event.entry);
+  HUNTER_CMD cmd = { HUNTER_CMD_TYPE::ZONE, event.zone, 0, 0, event.controller };
+  if (event.type == SCHEDULE_EVENT_TYPE::EV_START) {
+    if (!entry.days) {
+      return;
+    }
+    cmd = { entry.type, entry.zone, entry.time, entry.program, entry.controller };
+    if (entry.type == HUNTER_CMD_TYPE::ZONE) {
+      addEvent(minute + entry.time, SCHEDULE_EVENT_TYPE::EV_STOP, event.entry, entry.zone, entry.controller);
+    }
+    scheduleNext(event.entry, now, local);
+  }
+  STATS_ONLY(cmd.received = micros();)
+  LOG_INFO("Schedule entry %u %s", event.entry, (event.type == SCHEDULE_EVENT_TYPE::EV_START) ? "started" : "stopped");
+  if (!appData->pushHunterCmd(cmd)) {
+    LOG_WARN("hunter command queue full, scheduled command dropped");
+  }
+}
+
+/*!
+ * @brief adds the start event of the next run of an entry after the current minute
+ *
+ * @param entry   index of the entry
+ * @param minute  minutes since epoch
+ * @param local   local time of minute
+ */
+void WATER_SCHEDULE::scheduleNext(const byte entry, const uint32_t minute, const struct tm& local) {
+  const SCHEDULE_ENTRY& e = appData->getScheduleEntry(entry);
+  if (!e.days) {
+    return;
+  }
+  uint16_t nowOfDay = local.tm_hour * 60 + local.tm_min;
+  uint16_t at = e.hour * 60 + e.minute;
+  for (byte day = 0; day <= 7; day++) {
+    if ((e.days & (1 << ((local.tm_wday + day) % 7))) && ((day > 0) || (at > nowOfDay))) {
+      addEvent(minute + day * 1440UL + at - nowOfDay, SCHEDULE_EVENT_TYPE::EV_START, entry, 0, 0);
+      return;
+    }
+  }
+}
+
+/*!
+ * @brief adds an event to its slot of the wheel
+ *
+ * @param minute  minutes since epoch the event is due
+ * @param type    kind of the event
+ * @param entry   index of the schedule entry
+ * @param zone    zone to stop, EV_STOP only
+ * @param controller  controller of the zone, EV_STOP only
+ *
+ * @return success or failure if no event is free
+ */
+boolean WATER_SCHEDULE::addEvent(const uint32_t minute, const SCHEDULE_EVENT_TYPE type, const byte entry, const byte zone, const byte controller) {
+  if (freeList == NO_EVENT) {
+    LOG_ERROR("no free schedule event");
+    return false;
+  }
+  byte i = freeList;
+  freeList = events[i].next;
+  events[i] = { minute, type, entry, zone, controller, wheel[minute & (SCHEDULE_WHEEL_SLOTS - 1)] };
+  wheel[minute & (SCHEDULE_WHEEL_SLOTS - 1)] = i;
+  return true;
+}
@@ -0,0 +1,77 @@
+/*!
+ *  @file water_schedule.h
+ *
+ *  This is a class running the local watering schedule, independent of WIFI and MQTT.
+ *
+ *  Written by Hans-Joachim Zimmer.
+ *
+ *  MIT license, all text above must be included in any redistribution
+ */
+
+#ifndef WATER_SCHEDULE_H
+#define WATER_SCHEDULE_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "app_data.h"
+
+#define SCHEDULE_WHEEL_SLOTS  64          // minutes per turn of the timer wheel, power of 2
+#define SCHEDULE_EVENTS       (2 * SCHEDULE_MAX)  // one pending start and one zone stop per entry
+#define SCHEDULE_TZ           "CET-1CEST,M3.5.0,M10.5.0/3"  // POSIX time zone of the schedule entries
+#define SCHEDULE_NTP_SERVER   "pool.ntp.org"
+#define SCHEDULE_TIME_VALID   1700000000  // s, an earlier system time is not synchronized yet
+#define NO_EVENT              0xff
+
+/*!
+ *  @brief  Enum class for the kind of a pending event.
+ */
+enum class SCHEDULE_EVENT_TYPE : byte {
+  EV_START  = 0,    // run the entry, the next run is scheduled right away
+  EV_STOP   = 1,    // stop the zone of a run, switches the pump off as well
+};
+
+/*!
+ *  @brief  Struct for a pending event in the timer wheel.
+ */
+typedef struct {
+  uint32_t            minute;   // minutes since epoch the event is due
+  SCHEDULE_EVENT_TYPE type;
+  byte                entry;    // index of the schedule entry
+  byte                zone;     // zone to stop, EV_STOP only
+  byte                controller; // controller of the zone, EV_STOP only
+  byte                next;     // next event in the same slot or the free list
+} SCHEDULE_EVENT;
+
+/*!
+ *  @brief  Class that queues the watering commands of the schedule entries stored in APP_DATA.
+ *
+ *  Every used entry has exactly one pending start event, a zone run adds a stop event.
+ *  The events are hashed by their minute into the slots of a timer wheel, a tick only
+ *  looks at the events of its own slot. The time is taken from SNTP, once set the system
+ *  time keeps running during WIFI or broker outages.
+ */
+class WATER_SCHEDULE {
+public:
+  // constructor
+  WATER_SCHEDULE() : appData(nullptr), freeList(NO_EVENT), lastMinute(0), version(0), isDst(-1) {};
+  // public methods
+  void    initialize(APP_DATA* appData);
+  boolean isSynced() const { return time(nullptr) >= SCHEDULE_TIME_VALID; }
+  void    loop();
+
+private:
+  void    rebuild(const uint32_t minute, const struct tm& local);
+  void    tick(const uint32_t minute, const uint32_t now, const struct tm& local);
+  void    fire(const SCHEDULE_EVENT& event, const uint32_t minute, const uint32_t now, const struct tm& local);
+  void    scheduleNext(const byte entry, const uint32_t minute, const struct tm& local);
+  boolean addEvent(const uint32_t minute, const SCHEDULE_EVENT_TYPE type, const byte entry, const byte zone, const byte controller);
+  APP_DATA*       appData;
+  SCHEDULE_EVENT  events[SCHEDULE_EVENTS];
+  byte            wheel[SCHEDULE_WHEEL_SLOTS];  // first event of each slot
+  byte            freeList;
+  uint32_t        lastMinute;   // minutes since epoch of the last tick
+  uint16_t        version;      // schedule version the wheel was built for
+  int             isDst;        // tm_isdst of the last tick
+};
+
+#endif // WATER_SCHEDULE_H
@@ -6,6 +6,9 @@
  *  @section intro_sec Introduction
  *
  *  This is an abstraction class for a WIFI connection
+ *  Connecting does not block, the state is driven by the ESP8266 station events (got IP, disconnected).
+ *  BSSID and channel of the last good connection are cached in appData, a reconnect with the cache
+ *  skips the full scan and optionally DHCP. If it fails, a full connect is done.
  *
  *  @section author Author
  *
@@ -17,6 +20,7 @@
  */
  
  #include "WIFI.h"
+#include "logger.h"
 
 /*!
  * @brief initalizes the WIFI_CTRL class 
@@ -27,47 +31,42 @@
 void WIFI_CTRL::initialize(OLED* oled, APP_DATA* appData) {
     this->oled = oled;
     this->appData = appData;
+
+    // connection parameter are maintained by appData, reconnects by loop()
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
+
+    // events are called from the system context, only set flags, loop() does the work
+    gotIpHandler = WiFi.onStationModeGotIP([this](const WiFiEventStationModeGotIP& event) {
+      gotIp = true;
+    });
+    disconnectedHandler = WiFi.onStationModeDisconnected([this](const WiFiEventStationModeDisconnected& event) {
+      disconnected = true;
+    });
 }
 
 /*!
  * @brief Connect to a WIFI AP
  *
- * takes parameters from appData class and establish a WIFI connection
- * will not return until connection is established
+ * takes parameters from appData class and starts a WIFI connection
+ * returns right away, the connection is established in the background and observed by loop()
  *
- * @return success on connection or failure if not correct initialized
+ * @return success on started connection or failure if not correct initialized
  */
 boolean WIFI_CTRL::connect() {
-  if (WiFi.isConnected()) {
-    WiFi.disconnect();
-  }
-  char msg[40] = "Trying WIFI ";
-
   if (!appData) {
-    Serial.println("no valid appData or oled pointer");
+    LOG_ERROR("no valid appData or oled pointer");
     return false;
   }
-  strcat(msg, appData->getWifiSsid());
-  strcat(msg, " ...");
-  if (oled) {oled->updateAction(msg);}
-
-  // Set in station mode and connect
-  WiFi.begin(appData->getWifiSsid(), appData->getWifiPw());
-  Serial.println("");
-  Serial.print(msg );
-  
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
+  if (WiFi.isConnected()) {
+    WiFi.disconnect();
   }
-  Serial.println();
-  if (oled) {oled->updateWifiInfo(getOwnIp().c_str(), appData->getWifiSsid());}
-
-  Serial.print("Connected, IP address: ");
-  Serial.println(getOwnIp());
-  appData->setWifiIp(getOwnIp().c_str());
+  disconnected = false;
+  gotIp = false;
 
-  return true;
+  fastConnect = (appData->getWifiCache() != nullptr);
+  return begin(fastConnect);
 }
 
 /*!
@@ -75,19 +74,128 @@ boolean WIFI_CTRL::connect() {
  *
  * @return DHCP assigned WIFI IP address
  */
-String WIFI_CTRL::getOwnIp() {
-  return(WiFi.localIP().toString());
+IP_STRING WIFI_CTRL::getOwnIp() {
+  return ipString(WiFi.localIP());
 }
 
 /*!
  * @brief reestablish a broken WIFI connection
  *
- * shall be periodically called
+ * shall be periodically called, handles the station events and timeouts of running attempts
  *
  */
 void WIFI_CTRL::loop() {
-  if (! WiFi.isConnected()) {
-    Serial.println("WIFI connection lost, reconnecting");
-    this->connect();
+  if (gotIp) {
+    gotIp = false;
+    if (state == WIFI_STATE::LINK_CONNECTING) {
+      onGotIp();
+    }
+  }
+  if (disconnected) {
+    disconnected = false;
+    if (state == WIFI_STATE::LINK_CONNECTED) {
+      LOG_WARN("WIFI connection lost, reconnecting");
+      state = WIFI_STATE::LINK_IDLE;
+      STATS_ONLY(downSince = millis();)
+    } else if ((state == WIFI_STATE::LINK_CONNECTING) && fastConnect) {
+      // cached access point not reachable, do not wait for the timeout
+      connectStart -= WIFI_FAST_TIMEOUT;
+    }
+  }
+
+  switch (state) {
+    case WIFI_STATE::LINK_IDLE:
+      this->connect();
+      break;
+    case WIFI_STATE::LINK_CONNECTING:
+      if (fastConnect && (millis() - connectStart > WIFI_FAST_TIMEOUT)) {
+        LOG_WARN("WIFI fast reconnect failed, full connect");
+        STATS_COUNT(WIFI_FALLBACKS);
+        appData->invalidateWifiCache();
+        fastConnect = false;
+        begin(false);
+      } else if (millis() - connectStart > WIFI_CONNECT_TIMEOUT) {
+        LOG_WARN("WIFI connect timeout, trying again");
+        begin(false);
+      }
+      break;
+    case WIFI_STATE::LINK_CONNECTED:
+      // in case an event got lost
+      if (!WiFi.isConnected()) {
+        LOG_WARN("WIFI connection lost, reconnecting");
+        state = WIFI_STATE::LINK_IDLE;
+        STATS_ONLY(downSince = millis();)
+      }
+      break;
+  }
+}
+
+// ================================ Private functions ==================================
+
+/*!
+ * @brief starts a connection attempt
+ *
+ * @param useCache  true to connect to the cached BSSID and channel, optionally with the cached IP
+ *
+ * @return success on started connection
+ */
+boolean WIFI_CTRL::begin(boolean useCache) {
+  char msg[40] = "Trying WIFI ";
+  strncat(msg, appData->getWifiSsid(), sizeof(msg) - strlen(msg) - 5);
+  strcat(msg, " ...");
+  if (oled) {oled->updateAction(msg);}
+  LOG_INFO("%s%s", msg, useCache ? " (fast)" : "");
+
+  const WIFICacheStruct* cache = useCache ? appData->getWifiCache() : nullptr;
+  if (cache && WIFI_CACHED_IP) {
+    WiFi.config(IPAddress(cache->ip[0], cache->ip[1], cache->ip[2], cache->ip[3]),
+                IPAddress(cache->gateway[0], cache->gateway[1], cache->gateway[2], cache->gateway[3]),
+                IPAddress(cache->subnet[0], cache->subnet[1], cache->subnet[2], cache->subnet[3]),
+                IPAddress(cache->dns[0], cache->dns[1], cache->dns[2], cache->dns[3]));
+  } else {
+    // all 0 enables DHCP again
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+  }
+
+  // Set in station mode and connect
+  if (cache) {
+    WiFi.begin(appData->getWifiSsid(), appData->getWifiPw(), cache->channel, cache->bssid);
+  } else {
+    WiFi.begin(appData->getWifiSsid(), appData->getWifiPw());
+  }
+  state = WIFI_STATE::LINK_CONNECTING;
+  connectStart = millis();
+  return true;
+}
+
+/*!
+ * @brief work to be done when the connection is established
+ *
+ * stores BSSID, channel and the IP lease as fast reconnect cache
+ */
+void WIFI_CTRL::onGotIp() {
+  state = WIFI_STATE::LINK_CONNECTED;
+  if (oled) {oled->updateWifiInfo(getOwnIp().c_str(), appData->getWifiSsid());}
+
+  LOG_INFO("Connected in %lu ms, IP address: %s", (unsigned long)(millis() - connectStart), getOwnIp().c_str());
+  appData->setWifiIp(getOwnIp().c_str());
+  STATS_COUNT(WIFI_CONNECTS);
+  STATS_RECORD(WIFI_DOWN, millis() - downSince);
+
+  WIFICacheStruct cache;
+  memset(&cache, 0, sizeof(cache));
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  IPAddress ip = WiFi.localIP();
+  IPAddress gateway = WiFi.gatewayIP();
+  IPAddress subnet = WiFi.subnetMask();
+  IPAddress dns = WiFi.dnsIP();
+  for (byte i = 0; i < 4; i++) {
+    cache.ip[i] = ip[i];
+    cache.gateway[i] = gateway[i];
+    cache.subnet[i] = subnet[i];
+    cache.dns[i] = dns[i];
   }
+  // only marked to be stored if changed, stored with the next successful MQTT connection
+  appData->setWifiCache(cache);
 }
@@ -7,7 +7,7 @@
  *
  *  MIT license, all text above must be included in any redistribution
  */
- 
+
 #ifndef WIFI_CTRL_H
 #define WIFI_CTRL_H
 
@@ -15,23 +15,52 @@
 #include "ESP8266WiFi.h" //https://randomnerdtutorials.com/how-to-install-esp8266-board-arduino-ide/
 #include "oled.h"
 #include "app_data.h"
+#include "stats.h"
+#include "fixed_string.h"
 
 #define WIFI_SSID              "WLAN_SSID"     // default wifi SSID
 #define WIFI_PASSWORD          "WLAN_PASSWORD"    // default wifi password
 
+#define WIFI_FAST_TIMEOUT      3000    // ms, a fast reconnect taking longer falls back to a full scan and DHCP
+#define WIFI_CONNECT_TIMEOUT   20000   // ms, a full connect taking longer is started again
+#define WIFI_CACHED_IP         false   // true to reuse the last DHCP lease as static IP, reserve the address in your router
+
+/*!
+ *  @brief  States of the connection state machine.
+ */
+enum class WIFI_STATE : byte {
+  LINK_IDLE         = 0,    // not connected, no attempt running
+  LINK_CONNECTING   = 1,    // waiting for the got IP event
+  LINK_CONNECTED    = 2,
+};
+
 class WIFI_CTRL {
 public:
 	// constructor
-	WIFI_CTRL() : oled(nullptr), appData(nullptr) {};
+	WIFI_CTRL() : oled(nullptr), appData(nullptr), state(WIFI_STATE::LINK_IDLE), fastConnect(false),
+                gotIp(false), disconnected(false), connectStart(0) {};
   // public methods
   void    initialize(OLED* oled, APP_DATA* appData);
   void    loop();
   boolean connect();
+  WIFI_STATE getState() const { return state; }
 
 private:
     OLED* oled;
     APP_DATA* appData;
-    String getOwnIp();
+    WIFI_STATE        state;
+    boolean           fastConnect;    // running attempt uses the cache
+    volatile boolean  gotIp;          // set by station event
+    volatile boolean  disconnected;   // set by station event
+    uint32_t          connectStart;   // millis() of the running attempt
+    WiFiEventHandler  gotIpHandler;
+    WiFiEventHandler  disconnectedHandler;
+#if USE_STATS
+    uint32_t          downSince = 0;  // millis() the connection was lost
+#endif
+    boolean begin(boolean useCache);
+    void    onGotIp();
+    IP_STRING getOwnIp();
 };
 
 #endif // WIFI_CTRL_H